@@ -13,6 +13,8 @@
 
 #include <stdint.h>
 #include <functional>
+#include <string>
+#include <vector>
 #include "../Interface.h"
 #include "dsp/ringbuffer.h"
 
@@ -30,8 +32,40 @@ public:
 	virtual void StartStream(ringbuffer<int16_t>& input, int numofblock) = 0;
 	virtual void StopStream() = 0;
 	virtual bool Enumerate(unsigned char& idx, char* lbuf, const uint8_t* fw_data, uint32_t fw_size) = 0;
+
+	// what the stream does about a full inputbuffer; the USB completion never waits
+	//   for room. lost blocks show as gaps in the blocks' sequence numbers (see
+	//   ringbufferbase::Lost()). for the next StartStream(). per path:
+	//   overflow_block: Linux zero-copy holds back the transfers; the FX3 overruns
+	//     meanwhile, counted as lost blocks from the stall's length. the Linux copy
+	//     path can't hold back: as overflow_drop_newest. Windows holds back the
+	//     next transfer's submission, the overrun is not counted
+	//   overflow_drop_oldest: the new block is kept, once the backlog is skipped
+	//     (see ringbuffer::WriteDropOldest()); on Windows it is lost as well
+	virtual void SetOverflowPolicy(overflow_policy policy) { this->policy = policy; }
+
+	// USB transfers submitted and not yet completed, for the metrics
+	virtual int GetTransfersInFlight() { return 0; }
+
+protected:
+	overflow_policy policy = overflow_block;
+};
+
+// the handler of the index'th attached FX3, in the order of ListUsbDevices()
+extern "C" fx3class* CreateUsbHandler(int index = 0);
+
+struct fx3deviceinfo
+{
+	std::string manufacturer;
+	std::string product;
+	std::string serialNumber;
 };
 
-extern "C" fx3class* CreateUsbHandler();
+// the attached FX3s, also the ones still in the boot loader
+std::vector<fx3deviceinfo> ListUsbDevices();
+
+// replay of a raw ADC capture (int16) instead of the FX3, see FX3FileHandler.h;
+//   nullptr, if the file can't be mapped
+fx3class* CreateFileHandler(const char* filename, uint32_t pace_rate, bool loop);
 
 #endif // FX3CLASS_H
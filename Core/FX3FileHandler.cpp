@@ -0,0 +1,199 @@
+#include "FX3FileHandler.h"
+#include "config.h"
+#include "tracer.h"
+
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+
+fx3class* CreateFileHandler(const char* filename, uint32_t pace_rate, bool loop)
+{
+	auto handler = new fx3filehandler(filename, pace_rate, loop);
+	if (!handler->IsOpen())
+	{
+		delete handler;
+		return nullptr;
+	}
+	return handler;
+}
+
+fx3filehandler::fx3filehandler(const char* filename, uint32_t pace_rate, bool loop) :
+	samples(nullptr),
+	count(0),
+	pace_rate(pace_rate),
+	loop(loop),
+	position(0),
+#ifdef _WIN32
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr),
+#else
+	mapsize(0),
+#endif
+	run(false),
+	finished(false)
+{
+#ifdef _WIN32
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		DbgPrintf("fx3filehandler: can't open %s\n", filename);
+		return;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(int16_t))
+		return;
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+		return;
+	samples = (const int16_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (samples)
+		count = size.QuadPart / sizeof(int16_t);
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		DbgPrintf("fx3filehandler: can't open %s\n", filename);
+		return;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(int16_t))
+	{
+		void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			samples = (const int16_t*)map;
+			mapsize = st.st_size;
+			count = st.st_size / sizeof(int16_t);
+		}
+	}
+	close(fd);
+#endif
+	DbgPrintf("fx3filehandler: %s with %llu samples\n", filename, (unsigned long long)count);
+}
+
+fx3filehandler::~fx3filehandler()
+{
+	StopStream();
+
+#ifdef _WIN32
+	if (samples)
+		UnmapViewOfFile(samples);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+#else
+	if (samples)
+		munmap((void*)samples, mapsize);
+#endif
+}
+
+bool fx3filehandler::Open(const uint8_t* fw_data, uint32_t fw_size)
+{
+	// no firmware to load
+	return IsOpen();
+}
+
+bool fx3filehandler::GetHardwareInfo(uint32_t* data)
+{
+	// no radio: RadioHandlerClass takes the DummyRadio
+	const uint8_t d[4] = {
+		NORADIO, FIRMWARE_VER_MAJOR, FIRMWARE_VER_MINOR, 0
+	};
+
+	memcpy(data, d, sizeof(d));
+	return true;
+}
+
+void fx3filehandler::StartStream(ringbuffer<int16_t>& input, int numofblock)
+{
+	StopStream();
+
+	if (finished.load(std::memory_order_relaxed))
+		position = 0;   // replay again
+	finished.store(false, std::memory_order_relaxed);
+
+	run = true;
+	replay_thread = std::thread([this, &input]() { this->ReplayLoop(&input); });
+}
+
+void fx3filehandler::StopStream()
+{
+	run = false;
+	if (replay_thread.joinable())
+		replay_thread.join();
+}
+
+void fx3filehandler::ReplayLoop(ringbuffer<int16_t>* input)
+{
+	const uint32_t blocksize = input->getBlockSize();
+	const auto start = steady_clock::now();
+	uint64_t streamed = 0;
+	tracer::SetThreadName("file");
+
+	while (run)
+	{
+		if (position >= count && !loop)
+		{
+			finished.store(true, std::memory_order_release);
+			break;
+		}
+
+		// like the USB side: lose a block, where the policy does not allow waiting
+		if (policy == overflow_drop_oldest)
+			input->FlushPending();
+		int16_t* ptr = (policy == overflow_block) ? input->getWritePtr() : input->tryWritePtr();
+		if (!run)
+			break;
+		if (ptr == nullptr)
+		{
+			// drop_oldest keeps it, see below
+			if (policy != overflow_drop_oldest)
+				input->Lost();
+			lost.resize(blocksize);
+			ptr = lost.data();
+		}
+
+		// the file may end within the block: start over, or pad with zeros
+		const uint64_t started = ringbufferbase::Now();
+		uint32_t n = 0;
+		while (n < blocksize)
+		{
+			if (position >= count)
+			{
+				if (!loop)
+				{
+					memset(ptr + n, 0, (blocksize - n) * sizeof(int16_t));
+					break;
+				}
+				position = 0;
+			}
+			uint32_t chunk = (uint32_t)std::min<uint64_t>(blocksize - n, count - position);
+			memcpy(ptr + n, samples + position, chunk * sizeof(int16_t));
+			n += chunk;
+			position += chunk;
+		}
+		if (ptr != lost.data())
+			input->WriteDone();
+		else if (policy == overflow_drop_oldest)
+			input->WriteDropOldest(ptr);
+		if (tracer::IsEnabled())
+			tracer::Record("file", started, ringbufferbase::Now(), streamed / blocksize);
+		streamed += blocksize;
+
+		// paced: as the ADC would deliver the samples
+		if (pace_rate > 0)
+			std::this_thread::sleep_until(start + duration_cast<nanoseconds>(duration<double>((double)streamed / pace_rate)));
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef FX3FILEHANDLER_H
+#define FX3FILEHANDLER_H
+
+//
+// fx3class replaying a recorded raw ADC capture (int16 samples) from a file,
+// instead of streaming from the FX3: for offline processing and repeatable
+// benchmarks without hardware. the file is memory mapped.
+//
+
+#include "FX3Class.h"
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+class fx3filehandler : public fx3class
+{
+public:
+	// pace_rate: real ADC samples per second; 0: as fast as the consumer takes them
+	// loop: start over at the end of the file, instead of ending the stream there
+	fx3filehandler(const char* filename, uint32_t pace_rate, bool loop);
+	virtual ~fx3filehandler(void);
+
+	bool Open(const uint8_t* fw_data, uint32_t fw_size) override;
+	bool Control(FX3Command command, uint8_t data) override { return true; }
+	bool Control(FX3Command command, uint32_t data) override { return true; }
+	bool Control(FX3Command command, uint64_t data) override { return true; }
+	bool SetArgument(uint16_t index, uint16_t value) override { return true; }
+	bool GetHardwareInfo(uint32_t* data) override;
+	bool ReadDebugTrace(uint8_t* pdata, uint8_t len) override { return true; }
+	void StartStream(ringbuffer<int16_t>& input, int numofblock) override;
+	void StopStream() override;
+	bool Enumerate(unsigned char& idx, char* lbuf, const uint8_t* fw_data, uint32_t fw_size) override { return true; }
+
+	bool IsOpen() const { return samples != nullptr; }
+	uint64_t getSampleCount() const { return count; }
+
+	// the whole file was streamed (without loop)
+	bool Finished() const { return finished.load(std::memory_order_acquire); }
+
+private:
+	void ReplayLoop(ringbuffer<int16_t>* input);
+
+	const int16_t* samples;     // the mapped file
+	uint64_t count;             // number of samples in the file
+	uint32_t pace_rate;
+	bool loop;
+	uint64_t position;          // next sample to stream
+	std::vector<int16_t> lost;  // where a lost block goes
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	size_t mapsize;
+#endif
+
+	std::atomic<bool> run;
+	std::atomic<bool> finished;
+	std::thread replay_thread;
+};
+
+#endif // FX3FILEHANDLER_H
@@ -3,25 +3,45 @@
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
-#include "pffft/pf_mixer.h"
 #include "RadioHandler.h"
 #include "config.h"
 #include "fft_mt_r2iq.h"
 #include "config.h"
 #include "PScope_uti.h"
+#include "resampler.h"
+#include "RawRecorder.h"
+#include "tracer.h"
 #include "../Interface.h"
 
 #include <chrono>
 
 using namespace std::chrono;
 
-// transfer variables
+// a callback, which started then, returned: for the metrics and the trace
+void RadioHandlerClass::Callbacked(uint64_t started, uint64_t sample)
+{
+	const uint64_t finished = ringbufferbase::Now();
+	callbackTime.Add(finished - started);
+	if (tracer::IsEnabled())
+		tracer::Record("callback", started, finished, sample);
+}
 
-unsigned long Failures = 0;
+// the stamp of the block at the read position of a channel's output, which is
+//   decimated by ratio out of the ADC's real samples
+void RadioHandlerClass::Stamp(int channel, const ringbufferbase& buffer, int ratio)
+{
+	uint64_t sample = buffer.getReadSequence() * transferSamples / (2 * ratio);
+	if (resamplers[channel])
+		sample = (uint64_t)(sample * resamplers[channel]->getRatio() + 0.5);
+	stamps[channel].sample = sample;
+	stamps[channel].time = buffer.getReadTime();
+}
 
 void RadioHandlerClass::OnDataPacket()
 {
 	auto len = outputbuffer.getBlockSize() / 2 / sizeof(float);
+	const int ratio = r2iqCntrl->getRatio();
+	tracer::SetThreadName("callback");
 
 	while(run)
 	{
@@ -30,12 +50,7 @@ void RadioHandlerClass::OnDataPacket()
 		if (!run)
 			break;
 
-		if (fc != 0.0f)
-		{
-			std::unique_lock<std::mutex> lk(fc_mutex);
-			shift_limited_unroll_C_sse_inp_c((complexf*)buf, len, stateFineTune);
-		}
-
+		Stamp(0, outputbuffer, ratio);
 #ifdef _DEBUG		//PScope buffer screenshot
 		if (saveADCsamplesflag == true)
 		{
@@ -48,15 +63,96 @@ void RadioHandlerClass::OnDataPacket()
 		}
 #endif
 
-		Callback(callbackContext, buf, len);
+		const uint64_t started = ringbufferbase::Now();
+		if (resamplers[0])
+		{
+			uint32_t n;
+			{
+				tracescope scope("resample", stamps[0].sample);
+				n = resamplers[0]->Process(buf, len);
+			}
+			Callback(callbackContext, resamplers[0]->getOutput(), n);
+			SamplesXIF.fetch_add(n, std::memory_order_relaxed);
+		}
+		else
+		{
+			Callback(callbackContext, buf, len);
+			SamplesXIF.fetch_add(len, std::memory_order_relaxed);
+		}
+		Callbacked(started, stamps[0].sample);
 
 		outputbuffer.ReadDone();
+	}
+}
+
+void RadioHandlerClass::OnRawPacket()
+{
+	tracer::SetThreadName("callback");
+	while(run)
+	{
+		auto buf = inputbuffer.getReadPtr();
+
+		if (!run)
+			break;
 
-		SamplesXIF += len;
+		stamps[0].sample = inputbuffer.getReadSequence() * transferSamples;
+		stamps[0].time = inputbuffer.getReadTime();
+		const uint64_t started = ringbufferbase::Now();
+		RawCallback(rawCallbackContext, buf, transferSamples);
+		Callbacked(started, stamps[0].sample);
+		SamplesXIF.fetch_add(transferSamples, std::memory_order_relaxed);
+		inputbuffer.ReadDone();
+	}
+}
+
+void RadioHandlerClass::OnChannelPacket(int channel)
+{
+	ddcChannel* ch = channels[channel];
+	resampler* resample = resamplers[channel];
+	auto len = ch->outputbuffer.getBlockSize() / 2 / sizeof(float);
+	char name[16];
+	snprintf(name, sizeof(name), "channel %d", channel);
+	tracer::SetThreadName(name);
+
+	while(run)
+	{
+		auto buf = ch->outputbuffer.getReadPtr();
+
+		if (!run)
+			break;
+
+		Stamp(channel, ch->outputbuffer, 1 << ch->decimate);
+
+		const uint64_t started = ringbufferbase::Now();
+		if (resample)
+		{
+			uint32_t n;
+			{
+				tracescope scope("resample", stamps[channel].sample);
+				n = resample->Process(buf, len);
+			}
+			ch->Callback(ch->callbackContext, resample->getOutput(), n);
+		}
+		else
+		{
+			ch->Callback(ch->callbackContext, buf, len);
+		}
+		Callbacked(started, stamps[channel].sample);
+
+		ch->outputbuffer.ReadDone();
 	}
 }
 
 RadioHandlerClass::RadioHandlerClass() :
+	r2iqCntrl(nullptr),
+	Callback(nullptr),
+	callbackContext(nullptr),
+	RawCallback(nullptr),
+	rawCallbackContext(nullptr),
+	queueDepth(0),
+	overflowPolicy(overflow_block),
+	pullSequence(0),
+	pullHeld(false),
 	DbgPrintFX3(nullptr),
 	GetConsoleIn(nullptr),
 	run(false),
@@ -67,18 +163,40 @@ RadioHandlerClass::RadioHandlerClass() :
 	biasT_VHF(false),
 	firmware(0),
 	modeRF(NOMODE),
+	attRF(0),
+	gainIF(0),
+	recorder(nullptr),
+	saveADCsamplesflag(false),
+	BytesXferred(0),
+	SamplesXIF(0),
+	mBps(0.0f),
+	mSpsIF(0.0f),
+	usbStart(0),
+	metricsDump(0.0f),
+	fx3(nullptr),
 	adcrate(DEFAULT_ADC_FREQ),
-	fc(0.0f),
+	lofreq(0),
 	hardware(new DummyRadio(nullptr))
 {
+	spectrum = { 0, 0, 0.0f, nullptr, nullptr };
 	inputbuffer.setBlockSize(transferSamples);
-
-	stateFineTune = new shift_limited_unroll_C_sse_data_t();
+	for (int c = 0; c < NDDCCHANNELS; c++)
+	{
+		channels[c] = nullptr;
+		outputRates[c] = 0.0;
+		resamplers[c] = nullptr;
+		stamps[c] = { 0, 0 };
+	}
 }
 
 RadioHandlerClass::~RadioHandlerClass()
 {
-	delete stateFineTune;
+	StopRecording();
+	for (int c = 0; c < NDDCCHANNELS; c++)
+	{
+		delete channels[c];
+		delete resamplers[c];
+	}
 }
 
 const char *RadioHandlerClass::getName()
@@ -137,8 +255,7 @@ bool RadioHandlerClass::Init(fx3class* Fx3, void (*callback)(void*context, const
 		DbgPrintf("WARNING no SDR connected\n");
 		break;
 	}
-	adcrate = adcnominalfreq;
-	hardware->Initialize(adcnominalfreq);
+	hardware->Initialize(adcrate);
 	DbgPrintf("%s | firmware %x\n", hardware->getName(), firmware);
 	this->r2iqCntrl = r2iqCntrl;
 	r2iqCntrl->Init(hardware->getGain(), &inputbuffer, &outputbuffer);
@@ -152,7 +269,7 @@ bool RadioHandlerClass::Start(int srate_idx)
 	DbgPrintf("RadioHandlerClass::Start\n");
 
 	int	decimate = 4 - srate_idx;   // 5 IF bands
-	if (adcnominalfreq > N2_BANDSWITCH) 
+	if (adcrate > N2_BANDSWITCH) 
 		decimate = 5 - srate_idx;   // 6 IF bands
 	if (decimate < 0)
 	{
@@ -160,7 +277,8 @@ bool RadioHandlerClass::Start(int srate_idx)
 		DbgPrintf("WARNING decimate mismatch at srate_idx = %d\n", srate_idx);
 	}
 	run = true;
-	count = 0;
+	pullSequence = 0;
+	pullHeld = false;
 
 	hardware->FX3producerOn();  // FX3 start the producer
 
@@ -168,13 +286,72 @@ bool RadioHandlerClass::Start(int srate_idx)
 
 	// 0,1,2,3,4 => 32,16,8,4,2 MHz
 	r2iqCntrl->setDecimate(decimate);
-	r2iqCntrl->TurnOn();
+	if (spectrum.callback)
+		r2iqCntrl->setSpectrum(spectrum.bins, spectrum.frames, spectrumInterval(), spectrum.callback, spectrum.context);
+
+	// resample from the rate of the decimation, where wanted
+	for (int c = 0; c < NDDCCHANNELS; c++)
+	{
+		delete resamplers[c];
+		resamplers[c] = nullptr;
+		if (outputRates[c] <= 0.0 || (c > 0 && channels[c] == nullptr))
+			continue;
+
+		const int dec = (c == 0) ? decimate : channels[c]->decimate;
+		const double ratio = outputRates[c] / (getSampleRate() / 2.0 / (1 << dec));
+		if (ratio < 1.0)
+			resamplers[c] = new resampler(ratio);
+		else
+			DbgPrintf("WARNING channel %d output rate %f above its decimation's rate\n", c, outputRates[c]);
+	}
+	// the queue depth applies to what the callback consumes. the r2iq threads
+	//   reserve output blocks up to its window ahead of the oldest one in work,
+	//   which have to fit, or they wait forever
+	const int depth = queueDepth > 0 ? queueDepth : default_count;
+	inputbuffer.setCount(RawCallback ? depth : default_count);
+	outputbuffer.setCount(RawCallback ? default_count : std::max(depth, N_R2IQ_WINDOW + 1));
+
+	// Stop() left the buffers half filled, to unblock both sides: no stale
+	// blocks from the previous run
+	inputbuffer.Reset();
+	outputbuffer.Reset();
+	usbStart = inputbuffer.getWriteCount() + inputbuffer.getDroppedCount();
+	callbackTime.Reset();
+	for (int c = 1; c < NDDCCHANNELS; c++)
+	{
+		if (channels[c])
+			channels[c]->outputbuffer.Reset();
+	}
+	// start the stream first: it may (re)attach the USB frames as blocks
+	// of the inputbuffer, which must not happen while r2iq reads them
+	fx3->SetOverflowPolicy(overflowPolicy);
 	fx3->StartStream(inputbuffer, QUEUE_SIZE);
 
-	submit_thread = std::thread(
-		[this]() {
-			this->OnDataPacket();
-		});
+	if (RawCallback)
+	{
+		submit_thread = std::thread(
+			[this]() {
+				this->OnRawPacket();
+			});
+	}
+	else
+	{
+		r2iqCntrl->TurnOn();
+
+		if (Callback)
+		{
+			submit_thread = std::thread(
+				[this]() {
+					this->OnDataPacket();
+				});
+		}
+
+		for (int c = 1; c < NDDCCHANNELS; c++)
+		{
+			if (channels[c])
+				channels[c]->submit_thread = std::thread([this, c]() { this->OnChannelPacket(c); });
+		}
+	}
 
 	show_stats_thread = std::thread([this](void*) {
 		this->CaculateStats();
@@ -191,18 +368,28 @@ bool RadioHandlerClass::Stop()
 	{
 		run = false; // now waits for threads
 
-		r2iqCntrl->TurnOff();
-
+		// stop the producer first: it would block on a full inputbuffer,
+		// which is no longer consumed, when r2iq is already turned off
 		fx3->StopStream();
 
-		run = false; // now waits for threads
+		if (RawCallback)
+			inputbuffer.Stop();     // r2iq is off in raw mode
+		else
+			r2iqCntrl->TurnOff();
 
 		show_stats_thread.join(); //first to be joined
 		DbgPrintf("show_stats_thread join2\n");
 
-		submit_thread.join();
+		if (submit_thread.joinable())
+			submit_thread.join();
 		DbgPrintf("submit_thread join1\n");
 
+		for (int c = 1; c < NDDCCHANNELS; c++)
+		{
+			if (channels[c] && channels[c]->submit_thread.joinable())
+				channels[c]->submit_thread.join();
+		}
+
 		hardware->FX3producerOff();     //FX3 stop the producer
 	}
 	return true;
@@ -211,6 +398,7 @@ bool RadioHandlerClass::Stop()
 
 bool RadioHandlerClass::Close()
 {
+	StopRecording();
 	delete hardware;
 	hardware = nullptr;
 
@@ -219,7 +407,9 @@ bool RadioHandlerClass::Close()
 
 bool RadioHandlerClass::UpdateSampleRate(uint32_t samplefreq)
 {
-	hardware->Initialize(samplefreq);
+	// before Init(): the rate it starts the ADC with
+	if (hardware)
+		hardware->Initialize(samplefreq);
 
 	this->adcrate = samplefreq;
 
@@ -231,6 +421,7 @@ int RadioHandlerClass::UpdateattRF(int att)
 {
 	if (hardware->UpdateattRF(att))
 	{
+		attRF = att;
 		return att;
 	}
 	return 0;
@@ -241,6 +432,7 @@ int RadioHandlerClass::UpdateIFGain(int idx)
 {
 	if (hardware->UpdateGainIF(idx))
 	{
+		gainIF = idx;
 		return idx;
 	}
 
@@ -287,19 +479,228 @@ uint64_t RadioHandlerClass::TuneLO(uint64_t wishedFreq)
 	// we need shift the samples
 	int64_t offset = wishedFreq - actLo;
 	DbgPrintf("Offset freq %" PRIi64 "\n", offset);
-	float fc = r2iqCntrl->setFreqOffset(offset / (getSampleRate() / 2.0f));
-	if (GetmodeRF() == VHFMODE)
-		fc = -fc;   // sign change with sideband used
-	if (this->fc != fc)
+	// the rest below r2iq's bin step is mixed in by r2iq, too
+	r2iqCntrl->setFreqOffset(offset / (getSampleRate() / 2.0f));
+
+	// the channels move with the LO: keep them on their frequency
+	if (actLo != lofreq)
 	{
-		std::unique_lock<std::mutex> lk(fc_mutex);
-		*stateFineTune = shift_limited_unroll_C_sse_init(fc, 0.0F);
-		this->fc = fc;
+		lofreq = actLo;
+		for (int c = 1; c < NDDCCHANNELS; c++)
+		{
+			if (channels[c])
+				TuneChannel(c, channels[c]->freq);
+		}
 	}
 
 	return wishedFreq;
 }
 
+int RadioHandlerClass::AddChannel(int decimate, void (*callback)(void* context, const float*, uint32_t), void* context)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run)
+		return -1;
+
+	ddcChannel* ch = new ddcChannel();
+	ch->outputbuffer.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+	ch->Callback = callback;
+	ch->callbackContext = context;
+	ch->decimate = decimate;
+
+	int channel = r2iqCntrl->AddChannel(&ch->outputbuffer, decimate);
+	if (channel < 1 || channel >= NDDCCHANNELS)
+	{
+		delete ch;
+		return -1;
+	}
+
+	channels[channel] = ch;
+	// on the LO until tuned, in r2iq as well
+	TuneChannel(channel, lofreq);
+	DbgPrintf("AddChannel %d decimate %d\n", channel, decimate);
+	return channel;
+}
+
+bool RadioHandlerClass::RemoveChannel(int channel)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run || channel < 1 || channel >= NDDCCHANNELS || channels[channel] == nullptr)
+		return false;
+
+	r2iqCntrl->RemoveChannel(channel);
+	delete channels[channel];
+	channels[channel] = nullptr;
+	outputRates[channel] = 0.0;
+	return true;
+}
+
+bool RadioHandlerClass::SetOutputRate(int channel, double rate)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run || channel < 0 || channel >= NDDCCHANNELS || (channel > 0 && channels[channel] == nullptr))
+		return false;
+
+	outputRates[channel] = rate;
+	return true;
+}
+
+bool RadioHandlerClass::SetFftSize(int size)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run)
+		return false;
+
+	return r2iqCntrl->setFftSize(size);
+}
+
+bool RadioHandlerClass::SetSpectrum(int bins, int frames, float fps, r2iqSpectrumCb callback, void* context)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run || (callback && fps <= 0.0f))
+		return false;
+
+	spectrum = { bins, frames, fps, callback, context };
+	return r2iqCntrl->setSpectrum(bins, frames, spectrumInterval(), callback, context);
+}
+
+// input buffers per spectrum at the current adc rate
+int RadioHandlerClass::spectrumInterval() const
+{
+	if (spectrum.callback == nullptr)
+		return 1;
+	return std::max(1, (int)lround(adcrate / (spectrum.fps * (double)transferSamples)));
+}
+
+bool RadioHandlerClass::SetCallback(void (*callback)(void* context, const float*, uint32_t), void* context)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run)
+		return false;
+
+	this->Callback = callback;
+	this->callbackContext = context;
+	return true;
+}
+
+bool RadioHandlerClass::SetRawCallback(void (*callback)(void* context, const int16_t*, uint32_t), void* context)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run)
+		return false;
+
+	this->RawCallback = callback;
+	this->rawCallbackContext = context;
+	return true;
+}
+
+bool RadioHandlerClass::SetQueueDepth(int blocks)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	// the USB side's transfers wait for room in the raw input (see MIN_QUEUE_DEPTH)
+	if (run || blocks < 0 || (blocks > 0 && blocks < MIN_QUEUE_DEPTH))
+		return false;
+
+	this->queueDepth = blocks;
+	return true;
+}
+
+bool RadioHandlerClass::SetOverflowPolicy(overflow_policy policy)
+{
+	std::unique_lock<std::mutex> lk(stop_mutex);
+	if (run)
+		return false;
+
+	this->overflowPolicy = policy;
+	return true;
+}
+
+const float* RadioHandlerClass::AcquireBlock(uint32_t* samples, uint64_t* sequence)
+{
+	if (!run || Callback || RawCallback || pullHeld)
+		return nullptr;
+
+	auto buf = outputbuffer.getReadPtr();
+	if (!run)
+		return nullptr;
+
+	pullHeld = true;
+	Stamp(0, outputbuffer, r2iqCntrl->getRatio());
+	uint32_t len = outputbuffer.getBlockSize() / 2 / sizeof(float);
+	if (resamplers[0])
+	{
+		len = resamplers[0]->Process(buf, len);
+		buf = resamplers[0]->getOutput();
+	}
+	SamplesXIF.fetch_add(len, std::memory_order_relaxed);
+	*samples = len;
+	*sequence = pullSequence;
+	return buf;
+}
+
+void RadioHandlerClass::ReleaseBlock()
+{
+	if (!pullHeld)
+		return;
+
+	pullHeld = false;
+	pullSequence++;
+	if (run)
+		outputbuffer.ReadDone();
+}
+
+bool RadioHandlerClass::StartRecording(const char* path, uint64_t maxBytes, double maxSeconds)
+{
+	StopRecording();
+
+	const float* steps;
+	rawrecorder::info info;
+	info.sampleRate = adcrate;
+	info.frequency = (double)lofreq;
+	info.hardware = getName();
+	info.rfMode = (modeRF == VHFMODE) ? "VHF" : "HF";
+	info.rfGain = (GetRFAttSteps(&steps) > attRF) ? steps[attRF] : 0.0f;
+	info.ifGain = (GetIFGainSteps(&steps) > gainIF) ? steps[gainIF] : 0.0f;
+	info.dither = dither;
+	info.random = randout;
+
+	recorder = new rawrecorder(path, maxBytes, maxSeconds);
+	if (!recorder->Start(info) || !r2iqCntrl->setInputTap(rawrecorder::Tap, recorder))
+	{
+		delete recorder;
+		recorder = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool RadioHandlerClass::StopRecording()
+{
+	if (recorder == nullptr)
+		return false;
+
+	// no more blocks, before the recorder writes the rest
+	r2iqCntrl->setInputTap(nullptr, nullptr);
+	recorder->Stop();
+	delete recorder;
+	recorder = nullptr;
+	return true;
+}
+
+uint64_t RadioHandlerClass::TuneChannel(int channel, uint64_t freq)
+{
+	if (channel < 1 || channel >= NDDCCHANNELS || channels[channel] == nullptr)
+		return 0;
+
+	channels[channel]->freq = freq;
+	// same as TuneLO(), but the hardware LO stays where it is
+	int64_t offset = freq - lofreq;
+	DbgPrintf("Channel %d offset freq %" PRIi64 "\n", channel, offset);
+	r2iqCntrl->setChannelFreqOffset(channel, offset / (getSampleRate() / 2.0f));
+
+	return freq;
+}
+
 bool RadioHandlerClass::UptDither(bool b)
 {
 	dither = b;
@@ -331,6 +732,60 @@ bool RadioHandlerClass::UptRand(bool b)
 	return randout;
 }
 
+uint64_t RadioHandlerClass::UsbBlocks() const
+{
+	// written or lost by the producer; the ring's counters are not reset
+	return inputbuffer.getWriteCount() + inputbuffer.getDroppedCount() - usbStart;
+}
+
+static ringmetrics RingMetrics(const ringbufferbase& ring)
+{
+	ringmetrics m;
+	m.blocks = ring.getCount();
+	m.filled = ring.available();
+	m.highWater = ring.getHighWater();
+	m.fullWaits = ring.getFullCount();
+	m.emptyWaits = ring.getEmptyCount();
+	m.lost = ring.getLostCount();
+	return m;
+}
+
+pipelinemetrics RadioHandlerClass::GetMetrics() const
+{
+	pipelinemetrics m;
+	m.usbBytes = UsbBlocks() * transferSize;
+	m.usbBytesPerSec = mBps * 1e6f * sizeof(int16_t);
+	m.transfersInFlight = (run && fx3) ? fx3->GetTransfersInFlight() : 0;
+	m.outputSamplesPerSec = mSpsIF * 1e6f;
+	m.input = RingMetrics(inputbuffer);
+	m.output = RingMetrics(outputbuffer);
+	m.r2iqBlock = r2iqCntrl ? r2iqCntrl->getBlockTime().Get() : timehistogram::values();
+	m.callback = callbackTime.Get();
+	return m;
+}
+
+void RadioHandlerClass::DumpMetrics(FILE* out) const
+{
+	const pipelinemetrics m = GetMetrics();
+	auto ring = [out](const char* name, const ringmetrics& r) {
+		fprintf(out, " | %s %d/%d max %d, waits full %d empty %d, lost %" PRIu64,
+			name, r.filled, r.blocks, r.highWater, r.fullWaits, r.emptyWaits, r.lost);
+	};
+	auto times = [out](const char* name, const timehistogram::values& v) {
+		if (v.count == 0)
+			return;
+		fprintf(out, " | %s %.0f us, 99%% < %" PRIu64 " us, max %" PRIu64 " us", name,
+			v.total / 1000.0 / v.count, timehistogram::Percentile(v, 0.99) / 1000, v.max / 1000);
+	};
+
+	fprintf(out, "usb %.1f MB/s, %d in flight", m.usbBytesPerSec / 1e6f, m.transfersInFlight);
+	ring("input", m.input);
+	ring("output", m.output);
+	times("r2iq", m.r2iqBlock);
+	times("callback", m.callback);
+	fprintf(out, "\n");
+}
+
 void RadioHandlerClass::CaculateStats()
 {
 	high_resolution_clock::time_point EndingTime;
@@ -341,16 +796,23 @@ void RadioHandlerClass::CaculateStats()
 	kSReadIF = 0;
 
 	BytesXferred = 0;
-	SamplesXIF = 0;
+	SamplesXIF.store(0, std::memory_order_relaxed);
+	uint64_t usbBlocks = 0;
 
 	uint8_t  debdata[MAXLEN_D_USB];
 	memset(debdata, 0, MAXLEN_D_USB);
 
 	auto StartingTime = high_resolution_clock::now();
+	auto DumpTime = StartingTime;
 
 	while (run) {
+		// what came in over USB, lost blocks included
+		const uint64_t blocks = UsbBlocks();
+		BytesXferred = (unsigned long)((blocks - usbBlocks) * transferSize);
+		usbBlocks = blocks;
+
 		kbRead = float(BytesXferred) / 1000.0f;
-		kSReadIF = float(SamplesXIF) / 1000.0f;
+		kSReadIF = float(SamplesXIF.exchange(0, std::memory_order_relaxed)) / 1000.0f;
 
 		EndingTime = high_resolution_clock::now();
 
@@ -360,9 +822,13 @@ void RadioHandlerClass::CaculateStats()
 		mSpsIF = (float)kSReadIF / timeElapsed.count() / 1000;
 
 		BytesXferred = 0;
-		SamplesXIF = 0;
 
 		StartingTime = high_resolution_clock::now();
+		if (metricsDump > 0.0f && duration<float>(StartingTime - DumpTime).count() >= metricsDump)
+		{
+			DumpMetrics(stderr);
+			DumpTime = StartingTime;
+		}
 	
 #ifdef _DEBUG  
 		int nt = 10;
@@ -8,12 +8,44 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdint.h>
+#include <atomic>
 #include "FX3Class.h"
 
 #include "dsp/ringbuffer.h"
+#include "r2iq.h"
+#include "metrics.h"
 
 class RadioHardware;
 class r2iqControlClass;
+class resampler;
+class rawrecorder;
+
+// where a block of a stream starts, see RadioHandlerClass::GetStamp()
+struct blockstamp {
+    uint64_t sample;    // its first sample, counted at the stream's rate since Start()
+    uint64_t time;      // when the ADC block of that sample came in, see ringbufferbase::Now()
+};
+
+// a ring between two stages, see RadioHandlerClass::GetMetrics()
+struct ringmetrics {
+    int blocks;             // its size
+    int filled;             // now
+    int highWater;          // most blocks queued since Start()
+    int fullWaits;          // the producer waited for room; not reset
+    int emptyWaits;         // the consumer waited for a block; not reset
+    uint64_t lost;          // blocks dropped or skipped since Start()
+};
+
+struct pipelinemetrics {
+    uint64_t usbBytes;          // since Start(), lost blocks included
+    float usbBytesPerSec;       // over the last second or so
+    int transfersInFlight;
+    float outputSamplesPerSec;  // given to the main callback
+    ringmetrics input;          // USB to r2iq (or to the raw callback)
+    ringmetrics output;         // r2iq to the main callback
+    timehistogram::values r2iqBlock;    // processing an input block, per r2iq thread
+    timehistogram::values callback;     // the callbacks of all outputs
+};
 
 enum {
     RESULT_OK,
@@ -23,9 +55,6 @@ enum {
     RESULT_NOT_POSSIBLE
 };
 
-struct shift_limited_unroll_C_sse_data_s;
-typedef struct shift_limited_unroll_C_sse_data_s shift_limited_unroll_C_sse_data_t;
-
 class RadioHandlerClass {
 public:
     RadioHandlerClass();
@@ -69,6 +98,74 @@ public:
     uint64_t TuneLO(uint64_t lo);
     rf_mode PrepareLo(uint64_t lo);
 
+    // additional ddc channels from the same ADC stream, each with its own
+    //   decimation, frequency and callback. add and remove only while stopped;
+    //   AddChannel returns the channel (1 .. NDDCCHANNELS - 1), or -1. a new
+    //   channel is tuned to the LO, until TuneChannel()
+    int AddChannel(int decimate, void (*callback)(void* context, const float*, uint32_t), void* context = nullptr);
+    bool RemoveChannel(int channel);
+    uint64_t TuneChannel(int channel, uint64_t freq);
+
+    // resample the main output (channel 0) or a ddc channel to any rate below the
+    //   rate of its decimation, e.g. 2.4 Msps out of 4 Msps. the callback then gets
+    //   a varying number of samples per block. 0 turns it off; only while stopped
+    bool SetOutputRate(int channel, double rate);
+
+    // size of r2iq's first fft (see fft_mt_r2iq::setFftSize()): larger ones give
+    //   sharper filters, at more cpu and latency; only while stopped. 0: automatic
+    bool SetFftSize(int size);
+    int GetFftSize() const { return r2iqCntrl->getFftSize(); }
+
+    // power spectrum of the ADC input, 0 to adc rate / 2 in bins (a power of 2), out of
+    //   r2iq's ffts (see fft_mt_r2iq::setSpectrum()): each the mean of frames ffts, about
+    //   fps a second. called from an r2iq thread; nullptr turns it off; only while stopped
+    bool SetSpectrum(int bins, int frames, float fps, r2iqSpectrumCb callback, void* context = nullptr);
+
+    // the main output's callback, as with Init(); nullptr: pull mode. only while stopped
+    bool SetCallback(void (*callback)(void* context, const float*, uint32_t), void* context = nullptr);
+
+    // raw mode: the ADC's blocks of transferSamples go to the callback as they come in
+    //   (in place, e.g. in the USB frame), r2iq and the ddc channels stay off and so
+    //   does the recorder. nullptr: back to r2iq. only while stopped
+    bool SetRawCallback(void (*callback)(void* context, const int16_t*, uint32_t), void* context = nullptr);
+
+    // blocks queued between the producer and the consumer of the main output, or of
+    //   the raw input in raw mode; MIN_QUEUE_DEPTH at least, 0: default. only while stopped
+    bool SetQueueDepth(int blocks);
+
+    // what the USB side does about a full inputbuffer (see fx3class::SetOverflowPolicy());
+    //   only while stopped. the ADC blocks lost so far (since Start())
+    bool SetOverflowPolicy(overflow_policy policy);
+    uint64_t GetLostBlocks() const { return inputbuffer.getLostCount(); }
+
+    // pull mode, when Init() got no callback: the caller takes the main output's
+    //   blocks itself, in order and one at a time. AcquireBlock() waits for the next
+    //   one and returns its samples and sequence number (blocks since Start()), or
+    //   nullptr when stopped; ReleaseBlock() hands it back to r2iq
+    const float* AcquireBlock(uint32_t* samples, uint64_t* sequence);
+    void ReleaseBlock();
+    int BlocksReady() const { return run ? outputbuffer.available() : -1; }
+
+    // of the block given to a callback of the channel (0: the main output, or the
+    //   raw one) - valid within the callback - or of the block acquired. lost ADC
+    //   blocks count, so a jump beyond the samples delivered before is a gap; it shows
+    //   with the block after the gap, as r2iq fills an output block from 2^decimate
+    //   ADC blocks. resampled outputs count at their rate, rounded
+    blockstamp GetStamp(int channel = 0) const { return stamps[channel]; }
+
+    // record the raw ADC stream into SigMF files (see rawrecorder): <path>-0000.sigmf-data
+    //   with its .sigmf-meta, rotated to -0001, .. at maxBytes or maxSeconds (0: never).
+    //   before or while streaming; the metadata has the settings at the start
+    bool StartRecording(const char* path, uint64_t maxBytes = 0, double maxSeconds = 0.0);
+    bool StopRecording();
+    const rawrecorder* GetRecorder() const { return recorder; }
+
+    // the pipeline's counters, collected with relaxed atomics along the way. with
+    //   seconds > 0 a summary goes to stderr that often, while streaming; 0: off
+    pipelinemetrics GetMetrics() const;
+    void SetMetricsDump(float seconds) { metricsDump = seconds; }
+    void DumpMetrics(FILE* out) const;
+
     void uptLed(int led, bool on);
 
     void EnableDebug(void (*dbgprintFX3)(const char* fmt, ...), bool (*getconsolein)(char* buf, int maxlen)) 
@@ -79,20 +176,54 @@ public:
 
     bool ReadDebugTrace(uint8_t* pdata, uint8_t len) { return fx3->ReadDebugTrace(pdata, len); }
 
+    // debug builds: the next ADC block into ADCrealsamples.adc (PScope)
+    void SaveADCSamples() { saveADCsamplesflag = true; }
+
 private:
     void AdcSamplesProcess();
     void AbortXferLoop(int qidx);
     void CaculateStats();
     void OnDataPacket();
+    void OnRawPacket();
+    void Stamp(int channel, const ringbufferbase& buffer, int ratio);
+    void Callbacked(uint64_t started, uint64_t sample);
     r2iqControlClass* r2iqCntrl;
 
-    void (*Callback)(void* context, const float *data, uint32_t length);
+    struct ddcChannel {
+        ringbuffer<float> outputbuffer;
+        void (*Callback)(void* context, const float *data, uint32_t length);
+        void *callbackContext;
+        uint64_t freq;
+        int decimate;
+        std::thread submit_thread;
+    };
+    ddcChannel* channels[NDDCCHANNELS];   // [0] stays unused: that's the main output
+    double outputRates[NDDCCHANNELS];     // 0: no resampling
+    resampler* resamplers[NDDCCHANNELS];  // made in Start()
+    void OnChannelPacket(int channel);
+
+    void (*Callback)(void* context, const float *data, uint32_t length);   // nullptr: pull mode
     void *callbackContext;
+    void (*RawCallback)(void* context, const int16_t *data, uint32_t length);   // nullptr: r2iq
+    void *rawCallbackContext;
+    int queueDepth;         // 0: default
+    overflow_policy overflowPolicy;
+    uint64_t pullSequence;  // blocks released
+    bool pullHeld;          // a block acquired
+    blockstamp stamps[NDDCCHANNELS];  // set by the thread delivering the channel
+
+    struct {
+        int bins;
+        int frames;
+        float fps;
+        r2iqSpectrumCb callback;
+        void* context;
+    } spectrum;
+    int spectrumInterval() const;
     void (*DbgPrintFX3)(const char* fmt, ...);
     bool (*GetConsoleIn)(char* buf, int maxlen);
 
     bool run;
-    unsigned long count;    // absolute index
 
     bool pga;
     bool dither;
@@ -102,6 +233,10 @@ private:
     uint16_t firmware;
     rf_mode modeRF;
     RadioModel radio;
+    int attRF;          // step indices, as set
+    int gainIF;
+    rawrecorder* recorder;
+    bool saveADCsamplesflag;
 
     // transfer variables
     ringbuffer<int16_t> inputbuffer;
@@ -113,22 +248,22 @@ private:
 
     // stats
     unsigned long BytesXferred;
-    unsigned long SamplesXIF;
+    std::atomic<uint64_t> SamplesXIF;     // by the callback threads, or the caller (pull mode)
     float	mBps;
     float	mSpsIF;
+    uint64_t UsbBlocks() const;     // since Start()
+    uint64_t usbStart;              // the input's counters at Start()
+    timehistogram callbackTime;
+    float metricsDump;              // seconds, 0: off
 
     fx3class *fx3;
     uint32_t adcrate;
+    uint64_t lofreq;    // hardware LO, the channels are tuned relative to it
 
-    std::mutex fc_mutex;
     std::mutex stop_mutex;
-    float fc;
     RadioHardware* hardware;
-    shift_limited_unroll_C_sse_data_t* stateFineTune;
 };
 
-extern unsigned long Failures;
-
 class RadioHardware {
 public:
     RadioHardware(fx3class* fx3) : Fx3(fx3), gpios(0) {}
@@ -0,0 +1,397 @@
+#include "RawRecorder.h"
+#include "config.h"
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+
+// unbuffered writes need page aligned memory, sizes and offsets: blocks are 128 KiB
+static const size_t pageSize = 4096;
+static const size_t blockBytes = transferSamples * sizeof(int16_t);
+
+// without a size limit, files grow by this much preallocated space
+static const uint64_t preallocBytes = 256ull << 20;
+
+#ifdef _WIN32
+const rawrecorder::fileHandle rawrecorder::invalidFile = INVALID_HANDLE_VALUE;
+#else
+const rawrecorder::fileHandle rawrecorder::invalidFile = -1;
+#endif
+
+static double now()
+{
+	return duration<double>(system_clock::now().time_since_epoch()).count();
+}
+
+// ISO 8601 in UTC, as SigMF wants it
+static std::string iso_datetime(double seconds)
+{
+	time_t t = (time_t)seconds;
+	struct tm utc;
+#ifdef _WIN32
+	gmtime_s(&utc, &t);
+#else
+	gmtime_r(&t, &utc);
+#endif
+	char text[40];
+	size_t len = strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &utc);
+	snprintf(text + len, sizeof(text) - len, ".%06dZ", (int)((seconds - (double)t) * 1e6));
+	return text;
+}
+
+static std::string json_string(const std::string& s)
+{
+	std::string quoted = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		if ((unsigned char)c >= 0x20)
+			quoted += c;
+	}
+	return quoted + "\"";
+}
+
+rawrecorder::rawrecorder(const char* path, uint64_t maxBytes, double maxSeconds, int queueBlocks) :
+	path(path),
+	maxBytes(maxBytes / blockBytes * blockBytes),
+	maxSeconds(maxSeconds),
+	recording(),
+	queue(std::max(queueBlocks, 4)),
+	pool(nullptr),
+	direct(false),
+	file(invalidFile),
+	fileIndex(0),
+	fileBytes(0),
+	allocated(0),
+	fileStart(0.0),
+	gap(false),
+	tapSequence(0),
+	run(false),
+	pushed(0),
+	stopAt(0),
+	written(0),
+	dropped(0),
+	error(false)
+{
+	if (maxBytes > 0 && this->maxBytes == 0)
+		this->maxBytes = blockBytes;
+
+	// one piece, so the writer can take consecutive blocks with one write
+	const int count = queue.getCount();
+	pool = static_cast<int16_t*>(::operator new[](blockBytes * count, std::align_val_t(pageSize)));
+	std::vector<int16_t*> blocks(count);
+	for (int i = 0; i < count; i++)
+		blocks[i] = pool + (size_t)i * transferSamples;
+	queue.setBlocks(blocks.data());
+	blockTimes.assign(count, 0.0);
+	blockGaps.assign(count, 0);
+}
+
+rawrecorder::~rawrecorder()
+{
+	Stop();
+	::operator delete[](pool, std::align_val_t(pageSize));
+}
+
+std::string rawrecorder::FileName(const char* extension) const
+{
+	char number[16];
+	snprintf(number, sizeof(number), "-%04d", fileIndex);
+	return path + number + extension;
+}
+
+bool rawrecorder::Start(const info& recording)
+{
+	Stop();
+
+	this->recording = recording;
+	fileIndex = 0;
+	queue.Reset();
+	pushed = 0;
+	stopAt = UINT64_MAX;
+	written = 0;
+	dropped = 0;
+	error = false;
+	gap = false;
+	tapSequence = 0;
+
+	// the first file right away: no surprises once the stream runs
+	if (!OpenFile(now()))
+		return false;
+
+	run = true;
+	writer_thread = std::thread([this]() { this->WriterLoop(); });
+	return true;
+}
+
+void rawrecorder::Write(const int16_t* block)
+{
+	if (!run.load(std::memory_order_relaxed))
+		return;
+
+	// the writer is behind: rather lose this block than stall the stream
+	if (queue.available() >= queue.getCount() - 1)
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		gap = true;
+		return;
+	}
+
+	const uint64_t n = pushed.load(std::memory_order_relaxed);
+	const int slot = (int)(n % queue.getCount());
+	memcpy(queue.peekWritePtr(0), block, blockBytes);
+	blockTimes[slot] = now();
+	blockGaps[slot] = gap;
+	gap = false;
+	queue.WriteDone();
+	pushed.store(n + 1, std::memory_order_relaxed);
+}
+
+void rawrecorder::Tap(void* context, const int16_t* block, uint32_t samples, uint64_t sequence)
+{
+	rawrecorder* recorder = (rawrecorder*)context;
+	if (samples != transferSamples)
+		return;
+
+	if (sequence != recorder->tapSequence)
+		recorder->gap = true;
+	recorder->tapSequence = sequence + 1;
+	recorder->Write(block);
+}
+
+void rawrecorder::Stop()
+{
+	if (!run.exchange(false))
+		return;
+
+	// the stream no longer calls Write(): one more block past the last one wakes
+	// the writer, which stops there
+	stopAt.store(pushed.load(std::memory_order_relaxed), std::memory_order_release);
+	queue.getWritePtr();
+	queue.WriteDone();
+	writer_thread.join();
+
+	CloseFile();
+	fileIndex++;
+	DbgPrintf("rawrecorder: %llu blocks written, %llu dropped\n",
+		(unsigned long long)written.load(), (unsigned long long)dropped.load());
+}
+
+void rawrecorder::WriterLoop()
+{
+	const int count = queue.getCount();
+	uint64_t n = 0;     // blocks taken from the queue
+	for (;;)
+	{
+		queue.getReadPtr();
+		// the stop block is seen only after stopAt
+		const int ready = queue.available();
+		const uint64_t end = stopAt.load(std::memory_order_acquire);
+		if (n >= end)
+			break;
+
+		const int slot = (int)(n % count);
+		const double time = blockTimes[slot];
+		if (file != invalidFile && ((maxBytes > 0 && fileBytes >= maxBytes) ||
+			(maxSeconds > 0.0 && time - fileStart >= maxSeconds)))
+		{
+			// rotate
+			CloseFile();
+			fileIndex++;
+			OpenFile(time);
+		}
+		else if (fileBytes == 0)
+		{
+			segments[0].datetime = iso_datetime(time);
+		}
+		else if (blockGaps[slot])
+		{
+			segments.push_back({ fileBytes / sizeof(int16_t), iso_datetime(time) });
+		}
+
+		// as many as are ready, consecutive in the pool, fit into this file and
+		//   follow without a gap: one write
+		int blocks = std::min(ready, count - slot);
+		blocks = (int)std::min<uint64_t>(blocks, end - n);
+		if (maxBytes > 0)
+			blocks = (int)std::min<uint64_t>(blocks, std::max<uint64_t>((maxBytes - fileBytes) / blockBytes, 1));
+		for (int i = 1; i < blocks; i++)
+		{
+			if (blockGaps[slot + i])
+				blocks = i;
+		}
+
+		if (file != invalidFile && !WriteBlocks(pool + (size_t)slot * transferSamples, blocks))
+		{
+			// e.g. the disk is full: drain the queue, the stream must not stall
+			if (!error.exchange(true))
+				DbgPrintf("rawrecorder: write to %s failed\n", FileName(".sigmf-data").c_str());
+			CloseFile();
+		}
+		if (file != invalidFile)
+			written.fetch_add(blocks, std::memory_order_relaxed);
+
+		for (int i = 0; i < blocks; i++)
+			queue.ReadDone();
+		n += blocks;
+	}
+}
+
+bool rawrecorder::OpenFile(double time)
+{
+	const std::string name = FileName(".sigmf-data");
+	fileBytes = 0;
+	allocated = 0;
+	fileStart = time;
+	segments.clear();
+	segments.push_back({ 0, iso_datetime(time) });
+
+#ifdef _WIN32
+	direct = true;
+	file = CreateFileA(name.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+#else
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+	// page cache would only fill up with data nobody reads again soon
+	direct = true;
+	file = open(name.c_str(), flags | O_DIRECT, 0644);
+	if (file < 0 && errno == EINVAL)
+#endif
+	{
+		// e.g. tmpfs: no unbuffered writes
+		direct = false;
+		file = open(name.c_str(), flags, 0644);
+	}
+#endif
+	if (file == invalidFile)
+	{
+		DbgPrintf("rawrecorder: can't create %s\n", name.c_str());
+		error = true;
+		return false;
+	}
+
+	WriteMeta();
+	DbgPrintf("rawrecorder: %s%s\n", name.c_str(), direct ? "" : " (buffered)");
+	return true;
+}
+
+bool rawrecorder::WriteBlocks(const int16_t* data, int blocks)
+{
+	const size_t size = blocks * blockBytes;
+
+	// ahead of the writes: the file system can place the file in one piece
+	if (fileBytes + size > allocated)
+	{
+		uint64_t length = maxBytes > 0 ? maxBytes : std::max<uint64_t>(preallocBytes, size);
+#ifdef _WIN32
+		FILE_ALLOCATION_INFO alloc;
+		alloc.AllocationSize.QuadPart = allocated + length;
+		SetFileInformationByHandle(file, FileAllocationInfo, &alloc, sizeof(alloc));
+#elif defined(__linux__)
+		// keeping the size: readers see what is written so far
+		fallocate(file, FALLOC_FL_KEEP_SIZE, allocated, length);
+#endif
+		allocated += length;
+	}
+
+#ifdef _WIN32
+	LARGE_INTEGER offset;
+	offset.QuadPart = fileBytes;
+	SetFilePointerEx(file, offset, nullptr, FILE_BEGIN);
+	DWORD done;
+	if (!WriteFile(file, data, (DWORD)size, &done, nullptr) || done != size)
+		return false;
+#else
+	const char* bytes = (const char*)data;
+	for (size_t done = 0; done < size; )
+	{
+		ssize_t n = pwrite(file, bytes + done, size - done, fileBytes + done);
+#ifdef O_DIRECT
+		if (n < 0 && errno == EINVAL && direct)
+		{
+			// the file system refused unbuffered writes after all
+			direct = false;
+			fcntl(file, F_SETFL, fcntl(file, F_GETFL) & ~O_DIRECT);
+			continue;
+		}
+#endif
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+#endif
+	fileBytes += size;
+	return true;
+}
+
+void rawrecorder::CloseFile()
+{
+	if (file == invalidFile)
+		return;
+
+	// give back the preallocated rest
+#ifdef _WIN32
+	LARGE_INTEGER offset;
+	offset.QuadPart = fileBytes;
+	SetFilePointerEx(file, offset, nullptr, FILE_BEGIN);
+	SetEndOfFile(file);
+	CloseHandle(file);
+#else
+	if (ftruncate(file, fileBytes) != 0)
+		DbgPrintf("rawrecorder: can't truncate %s\n", FileName(".sigmf-data").c_str());
+	close(file);
+#endif
+	file = invalidFile;
+
+	// now with all capture segments
+	WriteMeta();
+}
+
+void rawrecorder::WriteMeta() const
+{
+	const std::string name = FileName(".sigmf-meta");
+	FILE* fp = fopen(name.c_str(), "w");
+	if (fp == nullptr)
+	{
+		DbgPrintf("rawrecorder: can't write %s\n", name.c_str());
+		return;
+	}
+
+	fprintf(fp, "{\n  \"global\": {\n");
+	fprintf(fp, "    \"core:datatype\": \"ri16_le\",\n");
+	fprintf(fp, "    \"core:sample_rate\": %.0f,\n", recording.sampleRate);
+	fprintf(fp, "    \"core:version\": \"1.0.0\",\n");
+	fprintf(fp, "    \"core:hw\": %s,\n", json_string(recording.hardware).c_str());
+	fprintf(fp, "    \"core:recorder\": \"sddc " SWVERSION "\",\n");
+	// the sddc: fields below, as the spec requires
+	fprintf(fp, "    \"core:extensions\": [ { \"name\": \"sddc\", \"version\": \"1.0.0\", \"optional\": true } ],\n");
+	fprintf(fp, "    \"sddc:rf_mode\": %s,\n", json_string(recording.rfMode).c_str());
+	fprintf(fp, "    \"sddc:rf_gain\": %.1f,\n", recording.rfGain);
+	fprintf(fp, "    \"sddc:if_gain\": %.1f,\n", recording.ifGain);
+	fprintf(fp, "    \"sddc:dither\": %s,\n", recording.dither ? "true" : "false");
+	fprintf(fp, "    \"sddc:adc_random\": %s\n", recording.random ? "true" : "false");
+	fprintf(fp, "  },\n  \"captures\": [\n");
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		fprintf(fp, "    { \"core:sample_start\": %llu, \"core:frequency\": %.0f, \"core:datetime\": \"%s\" }%s\n",
+			(unsigned long long)segments[i].sampleStart, recording.frequency, segments[i].datetime.c_str(),
+			i + 1 < segments.size() ? "," : "");
+	}
+	fprintf(fp, "  ],\n  \"annotations\": []\n}\n");
+	fclose(fp);
+}
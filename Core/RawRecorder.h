@@ -0,0 +1,111 @@
+#ifndef RAWRECORDER_H
+#define RAWRECORDER_H
+
+//
+// recorder of the raw ADC stream (int16 samples) into SigMF recordings:
+// <path>-0000.sigmf-data with <path>-0000.sigmf-meta, rotated to -0001, .. by size
+// or time. the stream hands over its blocks with Write(), which never blocks: it
+// copies into a queue of page aligned blocks (dropping the block, if full), a
+// writer thread takes them from there with large unbuffered writes (O_DIRECT,
+// FILE_FLAG_NO_BUFFERING) into preallocated files. dropped blocks start a new
+// capture segment in the metadata. fx3filehandler replays the data files.
+//
+
+#include "dsp/ringbuffer.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+class rawrecorder
+{
+public:
+	// what the metadata tells about the recording
+	struct info {
+		double sampleRate;      // of the ADC
+		double frequency;       // hardware LO, 0 for direct sampling
+		std::string hardware;
+		std::string rfMode;     // "HF", "VHF"
+		float rfGain;           // dB, negative: attenuation
+		float ifGain;           // dB
+		bool dither;
+		bool random;            // the samples are still randomized (LTC2208 RAND)
+	};
+
+	// maxBytes, maxSeconds: rotate to a new file at this size or duration; 0: never
+	// queueBlocks: transferSamples blocks between the stream and the writer
+	rawrecorder(const char* path, uint64_t maxBytes = 0, double maxSeconds = 0.0, int queueBlocks = 64);
+	virtual ~rawrecorder(void);
+
+	// open the first file and start the writer
+	bool Start(const info& recording);
+
+	// one block of transferSamples from the stream: copied, never blocking
+	void Write(const int16_t* block);
+
+	// write what is queued, close the file. the stream must not call Write() anymore
+	void Stop();
+
+	// for r2iq's input tap (see r2iqControlClass::setInputTap())
+	//   blocks lost before (a gap in the sequence) start a new capture segment, too
+	static void Tap(void* context, const int16_t* block, uint32_t samples, uint64_t sequence);
+
+	uint64_t getWritten() const { return written.load(std::memory_order_relaxed); }   // blocks
+	uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }   // blocks
+	int getFiles() const { return fileIndex + (file != invalidFile ? 1 : 0); }
+	bool getError() const { return error.load(std::memory_order_relaxed); }
+
+private:
+	struct segment {
+		uint64_t sampleStart;   // in the file
+		std::string datetime;
+	};
+
+	bool OpenFile(double time);
+	void CloseFile();
+	bool WriteBlocks(const int16_t* data, int blocks);
+	void WriteMeta() const;
+	std::string FileName(const char* extension) const;
+	void WriterLoop();
+
+	std::string path;
+	uint64_t maxBytes;          // whole blocks
+	double maxSeconds;
+	info recording;
+
+	ringbuffer<int16_t> queue;
+	int16_t* pool;              // the queue's blocks, one page aligned piece
+	bool direct;                // file opened unbuffered
+
+#ifdef _WIN32
+	typedef void* fileHandle;
+#else
+	typedef int fileHandle;
+#endif
+	static const fileHandle invalidFile;
+	fileHandle file;
+	int fileIndex;              // number of the current file
+	uint64_t fileBytes;         // written into the current file
+	uint64_t allocated;         // preallocated size of the current file
+	double fileStart;           // seconds since the epoch of its first block
+	std::vector<segment> segments;  // of the current file
+
+	// per queue slot, set by Write(): seconds since the epoch, when queued, and
+	// whether blocks were dropped before
+	std::vector<double> blockTimes;
+	std::vector<uint8_t> blockGaps;
+	bool gap;                   // Write() dropped a block since the last one queued
+	uint64_t tapSequence;       // the next one expected by Tap()
+
+	std::atomic<bool> run;
+	std::atomic<uint64_t> pushed;   // blocks queued by Write()
+	std::atomic<uint64_t> stopAt;   // the writer ends after these blocks
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> dropped;
+	std::atomic<bool> error;
+	std::thread writer_thread;
+};
+
+#endif // RAWRECORDER_H
@@ -1,24 +1,56 @@
+#include <algorithm>
 #include <string.h>
+#include <vector>
 
 #include "FX3handler.h"
 #include "usb_device.h"
 
-fx3class* CreateUsbHandler()
+fx3class* CreateUsbHandler(int index)
 {
-	return new fx3handler();
+	return new fx3handler(index);
 }
 
-fx3handler::fx3handler()
+std::vector<fx3deviceinfo> ListUsbDevices()
+{
+	std::vector<fx3deviceinfo> devices;
+	struct usb_device_info *infos;
+	if (usb_device_get_device_list(&infos) < 0)
+		return devices;
+
+	for (struct usb_device_info *info = infos; info->manufacturer || info->product || info->serial_number; info++)
+	{
+		fx3deviceinfo device;
+		device.manufacturer = info->manufacturer ? (const char*)info->manufacturer : "";
+		device.product = info->product ? (const char*)info->product : "";
+		device.serialNumber = info->serial_number ? (const char*)info->serial_number : "";
+		devices.push_back(device);
+	}
+	usb_device_free_device_list(infos);
+
+	return devices;
+}
+
+fx3handler::fx3handler(int index):
+    index(index),
+    dev(nullptr),
+    stream(nullptr),
+    inputbuffer(nullptr),
+    run(false),
+    zerocopy(false),
+    stallStart(0),
+    lastPacket(0),
+    packetNs(0)
 {
 }
 
 fx3handler::~fx3handler()
 {
+    CloseStream();
 }
 
 bool fx3handler::Open(const uint8_t* fw_data, uint32_t fw_size)
 {
-    dev = usb_device_open(0, (const char*)fw_data, fw_size);
+    dev = usb_device_open(index, (const char*)fw_data, fw_size);
 
     return dev != nullptr;
 }
@@ -51,14 +83,44 @@ bool fx3handler::GetHardwareInfo(uint32_t* data)
 
 void fx3handler::StartStream(ringbuffer<int16_t>& input, int numofblock)
 {
+    // the frames of the previous run may have been read by r2iq until it was
+    // turned off, so they are only released now
+    CloseStream();
+
     inputbuffer = &input;
-    auto readsize = input.getWriteCount() * sizeof(uint16_t);
-    stream = streaming_open_async(this->dev, readsize, numofblock, PacketRead, this);
+    auto readsize = input.getBlockSize() * sizeof(uint16_t);
+
+    // zero-copy: one USB frame for each block of the inputbuffer; r2iq reads
+    // the frames in place and they are resubmitted when it is done with them.
+    // that holds back the transfers, when the inputbuffer is full: overflow_block.
+    // otherwise the frames go out again right away, copied or dropped
+    zerocopy = false;
+    stream = nullptr;
+    stallStart = 0;
+    lastPacket = 0;
+    packetNs.store(0, std::memory_order_relaxed);
+    if (policy == overflow_block)
+        stream = streaming_open_async(this->dev, readsize, input.getCount(), PacketRead, this);
+    if (stream && streaming_frame_size(stream) == readsize)
+    {
+        zerocopy = AttachFrames();
+    }
+    if (!zerocopy)
+    {
+        if (stream)
+            streaming_close(stream);
+        input.setBlocks(nullptr);
+        stream = streaming_open_async(this->dev, readsize, numofblock, PacketRead, this);
+    }
+    DbgPrintf("fx3handler::StartStream %s\n", zerocopy ? "zero-copy" : "copy");
+    if (!zerocopy && policy == overflow_block)
+        DbgPrintf("fx3handler: overflow_block without zero-copy drops the newest blocks\n");
 
     // Start background thread to poll the events
     run = true;
     poll_thread = std::thread(
         [this]() {
+            tracer::SetThreadName("usb");
             while(run)
             {
                 usb_device_handle_events(this->dev);
@@ -68,27 +130,159 @@ void fx3handler::StartStream(ringbuffer<int16_t>& input, int numofblock)
     if (stream)
     {
         streaming_start(stream);
+        if (zerocopy)
+        {
+            // all blocks but the one kept for the overlap of the first read
+            for (int i = 0; i < input.getCount() - 1; i++)
+                streaming_release_frame(stream, i);
+        }
+    }
+}
+
+bool fx3handler::AttachFrames()
+{
+    int count = inputbuffer->getCount();
+    std::vector<int16_t*> blocks(count);
+    for (int i = 0; i < count; i++)
+    {
+        blocks[i] = (int16_t*)streaming_get_frame(stream, i);
+        if (blocks[i] == nullptr)
+            return false;
     }
+
+    if (streaming_set_manual_release(stream, 1) != 0)
+        return false;
+
+    inputbuffer->setBlocks(blocks.data());
+    inputbuffer->Reset();
+    inputbuffer->setReleaseCallback(FrameRelease, this);
+    return true;
 }
 
 void fx3handler::StopStream()
 {
-    run = false;
+    if (inputbuffer)
+        inputbuffer->setReleaseCallback(nullptr, nullptr);
+
+    {
+        std::unique_lock<std::mutex> lk(release_mutex);
+        run = false;
+    }
     poll_thread.join();
 
-    streaming_stop(stream);
-    streaming_close(stream);
+    if (stream)
+        streaming_stop(stream);
+
+    // closed with the next StartStream(): r2iq may still be on the frames
+    if (!zerocopy)
+        CloseStream();
+}
+
+void fx3handler::CloseStream()
+{
+    if (stream)
+    {
+        streaming_close(stream);
+        stream = nullptr;
+    }
 }
 
 void fx3handler::PacketRead(uint32_t data_size, uint8_t *data, void *context)
 {
     fx3handler *handler = (fx3handler*)context;
+    tracescope scope("usb", handler->inputbuffer->getWriteCount());
+    const uint32_t blockBytes = handler->inputbuffer->getBlockSize() * sizeof(int16_t);
 
-    auto *ptr = handler->inputbuffer->getWritePtr();
-    memcpy(ptr, data, data_size);
+    if (handler->zerocopy)
+    {
+        // the data is already in the block at the write position. a short
+        // transfer would leave the samples of the frame's previous use behind
+        if (data_size < blockBytes)
+        {
+            memset(data + data_size, 0, blockBytes - data_size);
+            handler->inputbuffer->Damaged();
+        }
+
+        // the time between transfers, to tell the blocks lost in a stall
+        const uint64_t now = ringbufferbase::Now();
+        if (handler->lastPacket)
+        {
+            const uint64_t interval = now - handler->lastPacket;
+            const uint64_t average = handler->packetNs.load(std::memory_order_relaxed);
+            handler->packetNs.store(average ? average - average / 16 + interval / 16 : interval,
+                std::memory_order_relaxed);
+        }
+        handler->lastPacket = now;
+        handler->inputbuffer->WriteDone();
+
+        // all frames are with r2iq now, none in flight: the FX3 overruns its
+        // FIFO, until r2iq hands one back (see FrameRelease())
+        auto full = [handler]() {
+            return handler->inputbuffer->available() >= handler->inputbuffer->getCount() - 1;
+        };
+        if (full())
+        {
+            std::unique_lock<std::mutex> lk(handler->release_mutex);
+            if (full())
+            {
+                handler->stallStart = now;
+                handler->lastPacket = 0;
+            }
+        }
+        return;
+    }
+
+    // the copy's block is whole, a short transfer padded with zeros
+    if (data_size < blockBytes)
+        memset(data + data_size, 0, blockBytes - data_size);
+
+    // never wait in the event thread: nothing can hold back the transfer, so
+    // overflow_block loses the new block as overflow_drop_newest does
+    if (handler->policy == overflow_drop_oldest)
+    {
+        if (data_size < blockBytes)
+            handler->inputbuffer->Damaged();
+        handler->inputbuffer->WriteDropOldest((const int16_t*)data);
+        return;
+    }
+
+    auto *ptr = handler->inputbuffer->tryWritePtr();
+    if (ptr == nullptr)
+    {
+        handler->inputbuffer->Lost();
+        return;
+    }
+
+    memcpy(ptr, data, blockBytes);
+    if (data_size < blockBytes)
+        handler->inputbuffer->Damaged();
     handler->inputbuffer->WriteDone();
 }
 
+void fx3handler::FrameRelease(void *context, int index)
+{
+    fx3handler *handler = (fx3handler*)context;
+
+    std::unique_lock<std::mutex> lk(handler->release_mutex);
+    if (!handler->run)
+        return;
+
+    // the end of a stall: the blocks the ADC delivered meanwhile are lost.
+    // no transfer is in flight, so the event thread does not write now
+    if (handler->stallStart)
+    {
+        const uint64_t average = handler->packetNs.load(std::memory_order_relaxed);
+        if (average > 0)
+        {
+            const uint64_t lost = (ringbufferbase::Now() - handler->stallStart) / average;
+            if (lost > 0)
+                handler->inputbuffer->Lost((int)std::min<uint64_t>(lost, INT32_MAX));
+        }
+        handler->stallStart = 0;
+    }
+    streaming_release_frame(handler->stream, index);
+}
+
 bool fx3handler::ReadDebugTrace(uint8_t* pdata, uint8_t len)
 {
 	return true;
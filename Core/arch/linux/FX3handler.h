@@ -11,11 +11,12 @@
 #include "usb_device.h"
 #include "streaming.h"
 #include "../../dsp/ringbuffer.h"
+#include "../../tracer.h"
 
 class fx3handler : public fx3class
 {
 public:
-	fx3handler();
+	fx3handler(int index = 0);
 	virtual ~fx3handler(void);
 	bool Open(const uint8_t* fw_data, uint32_t fw_size) override;
 	bool Control(FX3Command command, uint8_t data) override;
@@ -27,17 +28,27 @@ public:
 	void StartStream(ringbuffer<int16_t>& input, int numofblock) override;
 	void StopStream() override;
 	bool Enumerate(unsigned char &idx, char *lbuf, const uint8_t* fw_data, uint32_t fw_size) override;
+	int GetTransfersInFlight() override { return stream ? streaming_active_transfers(stream) : 0; }
 
 private:
 	bool ReadUsb(uint8_t command, uint16_t value, uint16_t index, uint8_t *data, size_t size);
 	bool WriteUsb(uint8_t command, uint16_t value, uint16_t index, uint8_t *data, size_t size);
 
 	static void PacketRead(uint32_t data_size, uint8_t *data, void *context);
+	static void FrameRelease(void *context, int index);
+	bool AttachFrames();
+	void CloseStream();
 
+	int index;                  // of the device, see usb_device_open()
 	usb_device_t *dev;
 	streaming_t *stream;
 	ringbuffer<int16_t> *inputbuffer;
     bool run;
+    bool zerocopy;              // USB transfers go straight into the inputbuffer blocks
+    std::mutex release_mutex;   // serializes frame resubmission against StopStream()
+    uint64_t stallStart;        // zero-copy: all frames with r2iq since; 0: none. with release_mutex
+    uint64_t lastPacket;        // zero-copy: time of the last transfer; 0 after a stall
+    std::atomic<uint64_t> packetNs; // average time between transfers
     std::thread poll_thread;
 };
 
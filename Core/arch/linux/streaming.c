@@ -58,6 +58,7 @@ enum StreamingStatus {
 typedef struct streaming {
   enum StreamingStatus status;
   int random;
+  int manual_release;
   usb_device_t *usb_device;
   uint32_t sample_rate;
   uint32_t frame_size;
@@ -90,6 +91,7 @@ streaming_t *streaming_open_sync(usb_device_t *usb_device)
   streaming_t *this = (streaming_t *) malloc(sizeof(streaming_t));
   this->status = STREAMING_STATUS_READY;
   this->random = 0;
+  this->manual_release = 0;
   this->usb_device = usb_device;
   this->sample_rate = DEFAULT_SAMPLE_RATE;
   this->frame_size = 0;
@@ -153,6 +155,7 @@ streaming_t *streaming_open_async(usb_device_t *usb_device, uint32_t frame_size,
   streaming_t *this = (streaming_t *) malloc(sizeof(streaming_t));
   this->status = STREAMING_STATUS_READY;
   this->random = 0;
+  this->manual_release = 0;
   this->usb_device = usb_device;
   this->sample_rate = DEFAULT_SAMPLE_RATE;
   this->frame_size = frame_size > 0 ? frame_size : DEFAULT_FRAME_SIZE;
@@ -213,6 +216,61 @@ int streaming_set_random(streaming_t *this, int random)
 }
 
 
+/* with manual release the frames are not resubmitted after the callback:
+ * the consumer works on them in place and hands each one back with
+ * streaming_release_frame() once done - in the same order it got them */
+int streaming_set_manual_release(streaming_t *this, int manual_release)
+{
+  if (this->status != STREAMING_STATUS_READY || this->callback == 0) {
+    return -1;
+  }
+  this->manual_release = manual_release;
+  return 0;
+}
+
+
+uint32_t streaming_frame_size(streaming_t *this)
+{
+  return this->frame_size;
+}
+
+
+int streaming_active_transfers(streaming_t *this)
+{
+  return atomic_load_explicit(&this->active_transfers, memory_order_relaxed);
+}
+
+
+uint8_t *streaming_get_frame(streaming_t *this, uint32_t index)
+{
+  if (this->frames == 0 || index >= this->num_frames) {
+    return 0;
+  }
+  return this->frames[index];
+}
+
+
+int streaming_release_frame(streaming_t *this, uint32_t index)
+{
+  if (!this->manual_release || index >= this->num_frames) {
+    return -1;
+  }
+  /* not an error: frames are handed back while stopping, too */
+  if (this->status != STREAMING_STATUS_STREAMING) {
+    return 0;
+  }
+
+  int ret = libusb_submit_transfer(this->transfers[index]);
+  if (ret < 0) {
+    log_usb_error(ret, __func__, __FILE__, __LINE__);
+    this->status = STREAMING_STATUS_FAILED;
+    return -1;
+  }
+  atomic_fetch_add(&this->active_transfers, 1);
+  return 0;
+}
+
+
 int streaming_start(streaming_t *this)
 {
   if (this->status != STREAMING_STATUS_READY) {
@@ -228,6 +286,11 @@ int streaming_start(streaming_t *this)
 
   /* submit all the transfers */
   atomic_init(&this->active_transfers, 0);
+  if (this->manual_release) {
+    /* the consumer submits them with streaming_release_frame() */
+    this->status = STREAMING_STATUS_STREAMING;
+    return 0;
+  }
   for (uint32_t i = 0; i < this->num_frames; ++i) {
     int ret = libusb_submit_transfer(this->transfers[i]);
     if (ret < 0) {
@@ -320,9 +383,7 @@ int streaming_read_sync(streaming_t *this, uint8_t *data, int length, int *trans
     uint16_t *samples = (uint16_t *) data;
     int n = *transferred / 2;
     for (int i = 0; i < n; ++i) {
-      if (samples[i] & 1) {
-        samples[i] ^= 0xfffe;
-      }
+      samples[i] ^= -(samples[i] & 1) & 0xfffe;
     }
   }
 
@@ -343,14 +404,17 @@ static void LIBUSB_CALL streaming_read_async_callback(struct libusb_transfer *tr
         if (this->random) {
           uint16_t *samples = (uint16_t *) transfer->buffer;
           int n = transfer->actual_length / 2;
+          /* branch-free, so the compiler can vectorize it */
           for (int i = 0; i < n; ++i) {
-            if (samples[i] & 1) {
-              samples[i] ^= 0xfffe;
-            }
+            samples[i] ^= -(samples[i] & 1) & 0xfffe;
           }
         }
         this->callback(transfer->actual_length, transfer->buffer,
                        this->callback_context);
+        if (this->manual_release) {
+          atomic_fetch_sub(&this->active_transfers, 1);
+          return;
+        }
         ret = libusb_submit_transfer(transfer);
         if (ret == 0) {
           return;
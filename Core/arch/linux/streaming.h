@@ -47,6 +47,17 @@ int streaming_set_sample_rate(streaming_t *that, uint32_t sample_rate);
 
 int streaming_set_random(streaming_t *that, int random);
 
+int streaming_set_manual_release(streaming_t *that, int manual_release);
+
+uint32_t streaming_frame_size(streaming_t *that);
+
+/* transfers submitted and not yet completed */
+int streaming_active_transfers(streaming_t *that);
+
+uint8_t *streaming_get_frame(streaming_t *that, uint32_t index);
+
+int streaming_release_frame(streaming_t *that, uint32_t index);
+
 int streaming_start(streaming_t *that);
 
 int streaming_stop(streaming_t *that);
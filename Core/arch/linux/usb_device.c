@@ -73,14 +73,15 @@ static int n_usb_device_ids = sizeof(usb_device_ids) / sizeof(usb_device_ids[0])
 int usb_device_count_devices()
 {
   int ret_val = -1;
+  libusb_context *ctx = 0;
 
-  int ret = libusb_init(0);
+  int ret = libusb_init(&ctx);
   if (ret < 0) {
     log_usb_error(ret, __func__, __FILE__, __LINE__);
     goto FAIL0;
   }
   libusb_device **list = 0;
-  ssize_t nusbdevices = libusb_get_device_list(0, &list);
+  ssize_t nusbdevices = libusb_get_device_list(ctx, &list);
   if (nusbdevices < 0) {
     log_usb_error(nusbdevices, __func__, __FILE__, __LINE__);
     goto FAIL1;
@@ -102,7 +103,7 @@ int usb_device_count_devices()
   ret_val = count;
 
 FAIL1:
-  libusb_exit(0);
+  libusb_exit(ctx);
 FAIL0:
   return ret_val;
 }
@@ -113,19 +114,20 @@ int usb_device_get_device_list(struct usb_device_info **usb_device_infos)
   const int MAX_STRING_BYTES = 256;
 
   int ret_val = -1;
+  libusb_context *ctx = 0;
 
   if (usb_device_infos == 0) {
     log_error("argument usb_device_infos is a null pointer", __func__, __FILE__, __LINE__);
     goto FAIL0;
   }
 
-  int ret = libusb_init(0);
+  int ret = libusb_init(&ctx);
   if (ret < 0) {
     log_usb_error(ret, __func__, __FILE__, __LINE__);
     goto FAIL0;
   }
   libusb_device **list = 0;
-  ssize_t nusbdevices = libusb_get_device_list(0, &list);
+  ssize_t nusbdevices = libusb_get_device_list(ctx, &list);
   if (nusbdevices < 0) {
     log_usb_error(nusbdevices, __func__, __FILE__, __LINE__);
     goto FAIL1;
@@ -159,7 +161,7 @@ int usb_device_get_device_list(struct usb_device_info **usb_device_infos)
           log_usb_error(ret, __func__, __FILE__, __LINE__);
           goto FAIL3;
         }
-        device_infos[count].manufacturer = (unsigned char *) realloc(device_infos[count].manufacturer, ret);
+        device_infos[count].manufacturer = (unsigned char *) realloc(device_infos[count].manufacturer, ret + 1);
       }
 
       device_infos[count].product = (unsigned char *) malloc(MAX_STRING_BYTES);
@@ -171,7 +173,7 @@ int usb_device_get_device_list(struct usb_device_info **usb_device_infos)
           log_usb_error(ret, __func__, __FILE__, __LINE__);
           goto FAIL3;
         }
-        device_infos[count].product = (unsigned char *) realloc(device_infos[count].product, ret);
+        device_infos[count].product = (unsigned char *) realloc(device_infos[count].product, ret + 1);
       }
 
       device_infos[count].serial_number = (unsigned char *) malloc(MAX_STRING_BYTES);
@@ -183,7 +185,7 @@ int usb_device_get_device_list(struct usb_device_info **usb_device_infos)
           log_usb_error(ret, __func__, __FILE__, __LINE__);
           goto FAIL3;
         }
-        device_infos[count].serial_number = (unsigned char *) realloc(device_infos[count].serial_number, ret);
+        device_infos[count].serial_number = (unsigned char *) realloc(device_infos[count].serial_number, ret + 1);
       }
 
       ret = 0;
@@ -206,7 +208,7 @@ FAIL3:
 FAIL2:
   libusb_free_device_list(list, 1);
 FAIL1:
-  libusb_exit(0);
+  libusb_exit(ctx);
 FAIL0:
   return ret_val;
 }
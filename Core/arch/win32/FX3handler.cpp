@@ -10,20 +10,22 @@
 #include <windows.h>
 #include "../../config.h"
 #include "FX3handler.h"
+#include <vector>
 #include "./CyAPI/CyAPI.h"
 #include "./CyAPI/cyioctl.h"
 #define RES_BIN_FIRMWARE                2000
 
 
-fx3class* CreateUsbHandler()
+fx3class* CreateUsbHandler(int index)
 {
-	return new fx3handler();
+	return new fx3handler(index);
 }
 
-fx3handler::fx3handler():
+fx3handler::fx3handler(int index):
 	fx3dev (nullptr),
 	Fx3IsOn (false),
-	devidx (0)
+	transfers (0),
+	devidx ((UCHAR)index)
 {
 
 }
@@ -45,8 +47,36 @@ char* wchar2char(const wchar_t* wchar)
 	return m_char;
 }
 
+std::vector<fx3deviceinfo> ListUsbDevices()
+{
+	std::vector<fx3deviceinfo> devices;
+	CCyFX3Device fx3dev;
+	int count = fx3dev.DeviceCount();
+	for (int i = 0; i < count; i++)
+	{
+		fx3deviceinfo device;
+		if (fx3dev.Open(i))
+		{
+			char* s = wchar2char((wchar_t*)fx3dev.Manufacturer);
+			device.manufacturer = s;
+			delete[] s;
+			s = wchar2char((wchar_t*)fx3dev.Product);
+			device.product = s;
+			delete[] s;
+			s = wchar2char((wchar_t*)fx3dev.SerialNumber);
+			device.serialNumber = s;
+			delete[] s;
+			fx3dev.Close();
+		}
+		devices.push_back(device);
+	}
+	return devices;
+}
+
 bool fx3handler::GetFx3DeviceStreamer() {   // open class 
 	bool r = false;
+	if (fx3dev == NULL)
+		fx3dev = new CCyFX3Device;          // opened without Enumerate()
 	if (fx3dev == NULL) return r;
 	fx3dev->Open(devidx);
 	if ((fx3dev->VendorID == VENDOR_ID) && (fx3dev->ProductID == STREAMER_ID)) r = true;
@@ -326,21 +356,36 @@ void fx3handler::CleanupDataXfer(void** context)
 	delete (readContext);
 }
 
-#define USB_READ_CONCURRENT 4
-
 void fx3handler::AdcSamplesProcess()
 {
 	DbgPrintf("AdcSamplesProc thread runs\n");
+	tracer::SetThreadName("usb");
 	int buf_idx;            // queue index
 	int read_idx;
 	void*		contexts[USB_READ_CONCURRENT];
+	bool		lost[USB_READ_CONCURRENT];  // transfer into lostblocks, the inputbuffer was full
+	int inflight = 0;       // transfers into the inputbuffer, ahead of its write position
+	std::vector<int16_t> lostblocks(USB_READ_CONCURRENT * transferSamples);
 
 	memset(contexts, 0, sizeof(contexts));
 
+	// into the next block of the inputbuffer, if there is room for it
+	auto submit = [&](int n) {
+		if (policy == overflow_block)
+			inputbuffer->getWritePtr(inflight);     // hold back, until there is
+		lost[n] = inputbuffer->available() + inflight >= inputbuffer->getCount() - 1;
+		uint8_t* ptr = lost[n] ? (uint8_t*)&lostblocks[n * transferSamples] : (uint8_t*)inputbuffer->peekWritePtr(inflight);
+		if (!lost[n])
+			inflight++;
+		if (!BeginDataXfer(ptr, transferSize, &contexts[n]))
+			return false;
+		transfers.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	};
+
 	// Queue-up the first batch of transfer requests
 	for (int n = 0; n < USB_READ_CONCURRENT; n++) {
-		auto ptr = inputbuffer->peekWritePtr(n);
-		if (!BeginDataXfer((uint8_t*)ptr, transferSize, &contexts[n])) {
+		if (!submit(n)) {
 			DbgPrintf("Xfer request rejected.\n");
 			return;
 		}
@@ -354,12 +399,23 @@ void fx3handler::AdcSamplesProcess()
 		if (!FinishDataXfer(&contexts[read_idx])) {
 			break;
 		}
-
-		inputbuffer->WriteDone();
+		transfers.fetch_sub(1, std::memory_order_relaxed);
+		tracescope scope("usb", inputbuffer->getWriteCount());
+
+		if (lost[read_idx]) {
+			// the transfers in flight own the next blocks, so the new one can't
+			// wait aside for room (ringbuffer::WriteDropOldest()): it is lost too
+			inputbuffer->Lost();
+			if (policy == overflow_drop_oldest)
+				inputbuffer->DiscardQueued();
+		}
+		else {
+			inputbuffer->WriteDone();
+			inflight--;
+		}
 
 		// Re-submit this queue element to keep the queue full
-		auto ptr = inputbuffer->peekWritePtr(USB_READ_CONCURRENT - 1);
-		if (!BeginDataXfer((uint8_t*)ptr, transferSize, &contexts[read_idx])) { // BeginDataXfer failed
+		if (!submit(read_idx)) { // BeginDataXfer failed
 			DbgPrintf("Xfer request rejected.\n");
 			break;
 		}
@@ -371,6 +427,7 @@ void fx3handler::AdcSamplesProcess()
 	for (int n = 0; n < USB_READ_CONCURRENT; n++) {
 		CleanupDataXfer(&contexts[n]);
 	}
+	transfers.store(0, std::memory_order_relaxed);
 
 	DbgPrintf("AdcSamplesProc thread_exit\n");
 	return;  // void *
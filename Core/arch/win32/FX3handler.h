@@ -18,6 +18,7 @@
 #include <time.h>
 
 #include "../../dsp/ringbuffer.h"
+#include "../../tracer.h"
 
 #define	VENDOR_ID     (0x04B4)
 #define	STREAMER_ID   (0x00F1)
@@ -31,7 +32,7 @@ class CCyUSBEndPoint;
 class fx3handler : public fx3class
 {
 public:
-	fx3handler();
+	fx3handler(int index = 0);
 	virtual ~fx3handler(void);
 
 	bool Open(const uint8_t* fw_data, uint32_t fw_size);
@@ -45,6 +46,7 @@ public:
 	void StartStream(ringbuffer<int16_t>& input, int numofblock);
 	void StopStream();
 	bool Enumerate(unsigned char &idx, char *lbuf, const uint8_t* fw_data, uint32_t fw_size);
+	int GetTransfersInFlight() { return transfers.load(std::memory_order_relaxed); }
 private:
 	bool SendI2cbytes(uint8_t i2caddr, uint8_t regaddr, uint8_t* pdata, uint8_t len);
 	bool ReadI2cbytes(uint8_t i2caddr, uint8_t regaddr, uint8_t* pdata, uint8_t len);
@@ -66,6 +68,7 @@ private:
 	ringbuffer<int16_t> *inputbuffer;
 	int numofblock;
 	bool run;
+	std::atomic<int> transfers;     // submitted, not yet finished
 	UCHAR devidx;
 };
 
@@ -50,10 +50,13 @@ inline void null_func(const char *format, ...) { }
 #define SWNAME				"ExtIO_sddc.dll"
 
 #define	QUEUE_SIZE 32
+// USB transfers in flight (Windows), each ahead of the inputbuffer's write position
+#define USB_READ_CONCURRENT 4
+// smallest inputbuffer a transfer can wait for room in (see RadioHandlerClass::SetQueueDepth()):
+//   the transfers in flight, the block kept back for the overlap and one to hand over
+#define MIN_QUEUE_DEPTH (USB_READ_CONCURRENT + 2)
 #define WIDEFFTN  // test FFTN 8192 
 
-#define FFTN_R_ADC (8192)       // FFTN used for ADC real stream DDC  tested at  2048, 8192, 32768, 131072
-
 // GAINFACTORS to be adjusted with lab reference source measured with HDSDR Smeter rms mode  
 #define BBRF103_GAINFACTOR 	(7.8e-8f)       // BBRF103
 #define HF103_GAINFACTOR   	(1.14e-8f)      // HF103
@@ -79,7 +82,7 @@ enum rf_mode { NOMODE = 0, HFMODE = 0x1, VHFMODE = 0x2 };
 #define MAXNDEV (4)  // max number of SDR device connected to PC
 #define MAXDEVSTRLEN (64)  //max char len of SDR device description
 
-extern bool saveADCsamplesflag;
+// the ExtIO's setting: the core takes it per device (RadioHandlerClass::UpdateSampleRate())
 extern uint32_t  adcnominalfreq;
 
 const uint32_t transferSize = 131072;
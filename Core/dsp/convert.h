@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stdint.h>
+
+// int16 ADC samples to float, optionally removing the ADC randomization
+//  (LTC2208 RAND: every sample with the LSB set has all other bits inverted)
+//
+// the SIMD kernel is selected at compile time by the instruction set the
+// including translation unit is built for (see Core/CMakeLists.txt).
+// all functions here have internal linkage: each fft_mt_r2iq_<isa>.cpp
+// gets its own copy, so r2iqThreadf's cpuid dispatch picks the kernel, too.
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CONVERT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CONVERT_NEON
+#endif
+
+// reference implementation: one sample at a time
+template<bool rand> static inline void convert_float_ref(const int16_t *input, float* output, int size)
+{
+    for (int m = 0; m < size; m++)
+    {
+        int16_t val;
+        if (rand && (input[m] & 1))
+        {
+            val = input[m] ^ (-2);
+        }
+        else
+        {
+            val = input[m];
+        }
+        output[m] = float(val);
+    }
+}
+
+// branch-free: the mask is 0xfffe for odd samples, 0 for even ones
+template<bool rand> static inline void convert_float_tail(const int16_t *input, float* output, int size)
+{
+    for (int m = 0; m < size; m++)
+    {
+        int16_t val = input[m];
+        if (rand)
+            val ^= -(val & 1) & -2;
+        output[m] = float(val);
+    }
+}
+
+template<bool rand> static inline void convert_float(const int16_t *input, float* output, int size)
+{
+    int m = 0;
+
+#if defined(__AVX512F__)
+    const __m256i lsb = _mm256_set1_epi16(1);
+    const __m256i nlsb = _mm256_set1_epi16(-2);
+    for (; m + 16 <= size; m += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(input + m));
+        if (rand)
+        {
+            __m256i mask = _mm256_cmpeq_epi16(_mm256_and_si256(v, lsb), lsb);
+            v = _mm256_xor_si256(v, _mm256_and_si256(mask, nlsb));
+        }
+        // maskz variants: the plain ones trigger GCC's -Wmaybe-uninitialized
+        const __m512i w = _mm512_maskz_cvtepi16_epi32(0xffff, v);
+        _mm512_storeu_ps(output + m, _mm512_maskz_cvtepi32_ps(0xffff, w));
+    }
+#elif defined(__AVX2__)
+    const __m128i lsb = _mm_set1_epi16(1);
+    const __m128i nlsb = _mm_set1_epi16(-2);
+    for (; m + 8 <= size; m += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(input + m));
+        if (rand)
+        {
+            __m128i mask = _mm_cmpeq_epi16(_mm_and_si128(v, lsb), lsb);
+            v = _mm_xor_si128(v, _mm_and_si128(mask, nlsb));
+        }
+        _mm256_storeu_ps(output + m, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)));
+    }
+#elif defined(__AVX__)
+    // no 256 bit integer ops: widen with SSE4.1, convert with AVX
+    const __m128i lsb = _mm_set1_epi16(1);
+    const __m128i nlsb = _mm_set1_epi16(-2);
+    for (; m + 8 <= size; m += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(input + m));
+        if (rand)
+        {
+            __m128i mask = _mm_cmpeq_epi16(_mm_and_si128(v, lsb), lsb);
+            v = _mm_xor_si128(v, _mm_and_si128(mask, nlsb));
+        }
+        __m128i lo = _mm_cvtepi16_epi32(v);
+        __m128i hi = _mm_cvtepi16_epi32(_mm_unpackhi_epi64(v, v));
+        _mm256_storeu_ps(output + m, _mm256_cvtepi32_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1)));
+    }
+#elif defined(CONVERT_SSE2)
+    const __m128i lsb = _mm_set1_epi16(1);
+    const __m128i nlsb = _mm_set1_epi16(-2);
+    for (; m + 8 <= size; m += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(input + m));
+        if (rand)
+        {
+            __m128i mask = _mm_cmpeq_epi16(_mm_and_si128(v, lsb), lsb);
+            v = _mm_xor_si128(v, _mm_and_si128(mask, nlsb));
+        }
+        // sign extend by shifting the interleaved copy down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(output + m, _mm_cvtepi32_ps(lo));
+        _mm_storeu_ps(output + m + 4, _mm_cvtepi32_ps(hi));
+    }
+#elif defined(CONVERT_NEON)
+    const int16x8_t lsb = vdupq_n_s16(1);
+    const int16x8_t nlsb = vdupq_n_s16(-2);
+    for (; m + 8 <= size; m += 8)
+    {
+        int16x8_t v = vld1q_s16(input + m);
+        if (rand)
+        {
+            int16x8_t mask = vreinterpretq_s16_u16(vceqq_s16(vandq_s16(v, lsb), lsb));
+            v = veorq_s16(v, vandq_s16(mask, nlsb));
+        }
+        vst1q_f32(output + m, vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))));
+        vst1q_f32(output + m + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))));
+    }
+#endif
+
+    convert_float_tail<rand>(input + m, output + m, size - m);
+}
+
+#undef CONVERT_SSE2
+#undef CONVERT_NEON
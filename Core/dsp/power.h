@@ -0,0 +1,74 @@
+#pragma once
+
+// power |X[k]|^2 of complex (interleaved re/im) float spectra, summed up over
+//  frames, e.g. for a spectrum display out of the DDC's forward ffts
+//
+// like convert.h: the SIMD kernel is selected at compile time by the instruction
+// set of the including translation unit, all functions have internal linkage.
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#define POWER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POWER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define POWER_NEON
+#endif
+
+// reference implementation: power[k] = |input[k]|^2, or += with add
+template<bool add> static inline void accumulate_power_ref(const float* input, float* power, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        float p = input[2 * k] * input[2 * k] + input[2 * k + 1] * input[2 * k + 1];
+        power[k] = add ? power[k] + p : p;
+    }
+}
+
+template<bool add> static inline void accumulate_power(const float* input, float* power, int count)
+{
+    int k = 0;
+
+#if defined(POWER_AVX)
+    // 4 bins per step: squares of 8 floats, each re^2 + im^2 pair added horizontally
+    for (; k + 4 <= count; k += 4)
+    {
+        __m256 v = _mm256_loadu_ps(input + 2 * k);
+        v = _mm256_mul_ps(v, v);
+        __m128 p = _mm_hadd_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        if (add)
+            p = _mm_add_ps(_mm_loadu_ps(power + k), p);
+        _mm_storeu_ps(power + k, p);
+    }
+#elif defined(POWER_SSE2)
+    // no horizontal add: gather the re^2 and the im^2 of 4 bins
+    for (; k + 4 <= count; k += 4)
+    {
+        __m128 a = _mm_loadu_ps(input + 2 * k);
+        __m128 b = _mm_loadu_ps(input + 2 * k + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        __m128 p = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        if (add)
+            p = _mm_add_ps(_mm_loadu_ps(power + k), p);
+        _mm_storeu_ps(power + k, p);
+    }
+#elif defined(POWER_NEON)
+    for (; k + 4 <= count; k += 4)
+    {
+        float32x4x2_t v = vld2q_f32(input + 2 * k);    // deinterleaved: re, im
+        float32x4_t p = vaddq_f32(vmulq_f32(v.val[0], v.val[0]), vmulq_f32(v.val[1], v.val[1]));
+        if (add)
+            p = vaddq_f32(vld1q_f32(power + k), p);
+        vst1q_f32(power + k, p);
+    }
+#endif
+
+    accumulate_power_ref<add>(input + 2 * k, power + k, count - k);
+}
+
+#undef POWER_AVX
+#undef POWER_SSE2
+#undef POWER_NEON
@@ -3,120 +3,338 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// hint the cpu, that we are busy waiting
+inline void spin_pause()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
 
 const int default_count = 64;
-const int spin_count = 100;
+const int spin_count_min = 16;      // adaptive spinning before yielding the cpu ..
+const int spin_count_max = 4096;
+const int yield_count = 8;          // .. and yielding before sleeping
 #define ALIGN (8)
+#define CACHELINE_SIZE (64)
+
+// what a producer, that must not wait (e.g. in a USB completion), does about a full ring
+enum overflow_policy {
+    overflow_block,         // hold back, until there is room (the default)
+    overflow_drop_newest,   // lose the new block
+    overflow_drop_oldest,   // lose the backlog: the consumer skips, what was queued
+                            //   before, and is up to date again (see WriteDropOldest())
+};
 
+// lock-free single producer / single consumer ring buffer of blocks
+//  indices are published with release and read with acquire semantics.
+//  a waiting side spins, then yields, then sleeps on a condition variable;
+//  the mutex is only taken when somebody sleeps (or on Stop())
+//
+//  each block gets a sequence number with WriteDone(), one higher than the block
+//  before, unless the producer lost blocks in between (see Lost()), and the time
+//  it was written (see Now())
 class ringbufferbase {
 public:
     ringbufferbase(int count) :
         max_count(count),
         read_index(0),
         write_index(0),
+        sequences(new uint64_t[count]()),
+        times(new uint64_t[count]()),
+        writeSequence(0),
+        pendingValid(false),
+        pendingSequence(0),
+        pendingTime(0),
+        discardBefore(0),
+        lostCount(0),
+        droppedCount(0),
+        highWater(0),
+        spin_count(spin_count_min),
+        sleepers(0),
+        releaseCallback(nullptr),
+        releaseContext(nullptr),
         emptyCount(0),
         fullCount(0),
         writeCount(0)
     {
     }
 
-    int getFullCount() const { return fullCount; }
+    int getFullCount() const { return fullCount.load(std::memory_order_relaxed); }
 
-    int getEmptyCount() const { return emptyCount; }
+    int getEmptyCount() const { return emptyCount.load(std::memory_order_relaxed); }
 
-    int getWriteCount() const { return writeCount; }
+    // blocks written since the ring was made; not reset
+    uint64_t getWriteCount() const { return writeCount.load(std::memory_order_relaxed); }
 
-    void ReadDone()
+    // blocks lost by the producer, or skipped by the consumer
+    uint64_t getLostCount() const { return lostCount.load(std::memory_order_relaxed); }
+
+    // of those, the ones lost by the producer (see Lost()); not reset
+    uint64_t getDroppedCount() const { return droppedCount.load(std::memory_order_relaxed); }
+
+    // the most blocks ever queued, since Reset()
+    int getHighWater() const { return highWater.load(std::memory_order_relaxed); }
+
+    int getCount() const { return max_count; }
+
+    // blocks written but not yet read; full at getCount() - 1
+    int available() const { return filled(); }
+
+    // called from ReadDone() with the index of the block, which got free for
+    // writing again. the block just read stays valid until the next ReadDone(),
+    // as readers may look back with peekReadPtr(-1)
+    void setReleaseCallback(void (*callback)(void* context, int index), void* context)
     {
         std::unique_lock<std::mutex> lk(mutex);
-        if ((write_index + 1) % max_count == read_index)
-        {
-            read_index = (read_index + 1) % max_count;
-            nonfullCV.notify_all();
-        }
-        else
-        {
-            read_index = (read_index + 1) % max_count;
-        }
+        releaseContext = context;
+        releaseCallback.store(callback, std::memory_order_release);
+    }
+
+    void ReadDone()
+    {
+        int index = read_index.load(std::memory_order_relaxed);
+        read_index.store((index + 1) % max_count, std::memory_order_release);
+        WakeUp();
+
+        auto callback = releaseCallback.load(std::memory_order_acquire);
+        if (callback)
+            callback(releaseContext, (index + max_count - 1) % max_count);
     }
 
     void WriteDone()
     {
-        std::unique_lock<std::mutex> lk(mutex);
-        if (read_index == write_index)
-        {
-            write_index = (write_index + 1) % max_count;
-            nonemptyCV.notify_all();
-        }
-        else
+        WriteDone(writeSequence, Now());
+    }
+
+    // with the stamp of another block, e.g. of the input it was made of
+    void WriteDone(uint64_t sequence, uint64_t time)
+    {
+        int index = write_index.load(std::memory_order_relaxed);
+        sequences[index] = sequence;
+        times[index] = time;
+        writeSequence = sequence + 1;
+        write_index.store((index + 1) % max_count, std::memory_order_release);
+        writeCount.fetch_add(1, std::memory_order_relaxed);
+        const int n = filled();
+        if (n > highWater.load(std::memory_order_relaxed))
+            highWater.store(n, std::memory_order_relaxed);
+        WakeUp();
+    }
+
+    // producer: blocks, which did not make it into the ring (e.g. it was full)
+    void Lost(int blocks = 1)
+    {
+        writeSequence += blocks;
+        lostCount.fetch_add(blocks, std::memory_order_relaxed);
+        droppedCount.fetch_add(blocks, std::memory_order_relaxed);
+    }
+
+    // producer: the next block written is incomplete (e.g. a short transfer, its
+    //   rest zeroed). it keeps its place in the sequence, but counts as lost
+    void Damaged()
+    {
+        lostCount.fetch_add(1, std::memory_order_relaxed);
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // producer: the blocks queued so far are stale, the consumer skips them
+    //   with Discard() (overflow_drop_oldest)
+    void DiscardQueued()
+    {
+        discardBefore.store(writeSequence, std::memory_order_release);
+    }
+
+    bool DiscardPending() const
+    {
+        return filled() > 0 && sequences[read_index.load(std::memory_order_relaxed)] <
+            discardBefore.load(std::memory_order_acquire);
+    }
+
+    // consumer, with no block in use: skip the stale blocks; the number of them
+    int Discard()
+    {
+        int skipped = 0;
+        while (DiscardPending())
         {
-            write_index = (write_index + 1) % max_count;
+            ReadDone();
+            skipped++;
         }
-        writeCount++;
+        lostCount.fetch_add(skipped, std::memory_order_relaxed);
+        return skipped;
+    }
+
+    // sequence number of the block 'offset' after the read position
+    uint64_t getReadSequence(int offset = 0) const
+    {
+        return sequences[(read_index.load(std::memory_order_relaxed) + max_count + offset) % max_count];
+    }
+
+    // when it was written, see Now()
+    uint64_t getReadTime(int offset = 0) const
+    {
+        return times[(read_index.load(std::memory_order_relaxed) + max_count + offset) % max_count];
+    }
+
+    // the host's monotonic clock in ns
+    static uint64_t Now()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
     }
 
     void Stop()
     {
         std::unique_lock<std::mutex> lk(mutex);
-        read_index = 0;
-        write_index = max_count / 2;
-        nonfullCV.notify_all();
-        nonemptyCV.notify_all();
+        discardBefore.store(0, std::memory_order_relaxed);
+        read_index.store(0, std::memory_order_release);
+        write_index.store(max_count / 2, std::memory_order_release);
+        wakeCV.notify_all();
+    }
+
+    // make empty again; neither producer nor consumer may be active
+    void Reset()
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        read_index.store(0, std::memory_order_release);
+        write_index.store(0, std::memory_order_release);
+        writeSequence = 0;
+        pendingValid = false;
+        discardBefore.store(0, std::memory_order_relaxed);
+        lostCount.store(0, std::memory_order_relaxed);
+        highWater.store(0, std::memory_order_relaxed);
+    }
+
+    ~ringbufferbase()
+    {
+        delete[] sequences;
+        delete[] times;
     }
 
 protected:
+    void resize(int count)
+    {
+        delete[] sequences;
+        delete[] times;
+        max_count = count;
+        sequences = new uint64_t[count]();
+        times = new uint64_t[count]();
+    }
 
-    void WaitUntilNotEmpty()
+    // number of blocks written but not yet read
+    int filled() const
     {
-        // if not empty
-        for (int i = 0; i < spin_count; i++)
-        {
-            if (read_index != write_index)
-                return;
-        }
+        int w = write_index.load(std::memory_order_acquire);
+        int r = read_index.load(std::memory_order_acquire);
+        return (w - r + max_count) % max_count;
+    }
 
-        if (read_index == write_index)
-        {
-            std::unique_lock<std::mutex> lk(mutex);
+    // wait until block 'offset' after the read position is filled
+    void WaitUntilNotEmpty(int offset = 0)
+    {
+        if (filled() > offset)
+            return;
 
-            emptyCount++;
-            nonemptyCV.wait(lk, [this] {
-                return read_index != write_index;
-            });
-        }
+        emptyCount.fetch_add(1, std::memory_order_relaxed);
+        Wait([this, offset] { return filled() > offset; });
+    }
+
+    // wait until block 'offset' after the write position is free
+    void WaitUntilNotFull(int offset = 0)
+    {
+        if (filled() + offset < max_count - 1)
+            return;
+
+        fullCount.fetch_add(1, std::memory_order_relaxed);
+        Wait([this, offset] { return filled() + offset < max_count - 1; });
     }
 
-    void WaitUntilNotFull()
+    int max_count;
+
+    alignas(CACHELINE_SIZE) std::atomic<int> read_index;
+    alignas(CACHELINE_SIZE) std::atomic<int> write_index;
+    uint64_t* sequences;        // of each block, set by WriteDone()
+    uint64_t* times;
+    uint64_t writeSequence;     // of the next block written; producer only
+    bool pendingValid;          // a block kept aside by WriteDropOldest(); producer only
+    uint64_t pendingSequence;
+    uint64_t pendingTime;
+    std::atomic<uint64_t> discardBefore;
+    std::atomic<uint64_t> lostCount;
+    std::atomic<uint64_t> droppedCount;
+    std::atomic<int> highWater;     // producer only
+
+private:
+    template<typename Pred> void Wait(Pred ready)
     {
-        for (int i = 0; i < spin_count; i++)
+        // spin: the other side is usually just a few microseconds away
+        int spins = spin_count.load(std::memory_order_relaxed);
+        for (int i = 0; i < spins; i++)
         {
-            if ((write_index + 1) % max_count != read_index)
+            if (ready())
+            {
+                // spinning was successful: allow spinning longer next time
+                if (spins < spin_count_max)
+                    spin_count.store(spins * 2, std::memory_order_relaxed);
                 return;
+            }
+            spin_pause();
         }
 
-        if ((write_index + 1) % max_count == read_index)
+        for (int i = 0; i < yield_count; i++)
         {
-            std::unique_lock<std::mutex> lk(mutex);
-            fullCount++;
-            nonfullCV.wait(lk, [this] {
-                return (write_index + 1) % max_count != read_index;
-            });
+            std::this_thread::yield();
+            if (ready())
+                return;
         }
+
+        // sleep: spinning was in vain, spin shorter next time
+        if (spins > spin_count_min)
+            spin_count.store(spins / 2, std::memory_order_relaxed);
+
+        std::unique_lock<std::mutex> lk(mutex);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        wakeCV.wait(lk, ready);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
     }
 
-    int max_count;
+    void WakeUp()
+    {
+        // pairs with the sleepers increment in Wait(): either the sleeper
+        // sees the new index, or we see the sleeper
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            wakeCV.notify_all();
+        }
+    }
 
-    volatile int read_index;
-    volatile int write_index;
+    std::atomic<int> spin_count;
 
-private:
-    int emptyCount;
-    int fullCount;
-    int writeCount;
+    alignas(CACHELINE_SIZE) std::atomic<int> sleepers;
+    std::atomic<void (*)(void* context, int index)> releaseCallback;
+    void* releaseContext;
+    std::atomic<int> emptyCount;
+    std::atomic<int> fullCount;
+    std::atomic<uint64_t> writeCount;
 
     std::mutex mutex;
-    std::condition_variable nonemptyCV;
-    std::condition_variable nonfullCV;
+    std::condition_variable wakeCV;
 };
 
 template<typename T> class ringbuffer : public ringbufferbase {
@@ -124,7 +342,9 @@ template<typename T> class ringbuffer : public ringbufferbase {
 
 public:
     ringbuffer(int count = default_count) :
-        ringbufferbase(count)
+        ringbufferbase(count),
+        block_size(0),
+        data(nullptr)
     {
         buffers = new TPtr[max_count];
         buffers[0] = nullptr;
@@ -132,8 +352,7 @@ public:
 
     ~ringbuffer()
     {
-        if (buffers[0])
-            delete[] buffers[0];
+        freeData();
 
         delete[] buffers;
     }
@@ -144,48 +363,154 @@ public:
         {
             block_size = size;
 
-            if (buffers[0])
-                delete[] buffers[0];
+            freeData();
 
-            int aligned_block_size = (block_size + ALIGN - 1) & (~(ALIGN - 1));
+            // cache line aligned blocks, so they can be handed to SIMD code
+            // (and fftw's new-array execute functions) directly
+            data = static_cast<T*>(::operator new[](sizeof(T) * max_count * alignedBlockSize(),
+                std::align_val_t(CACHELINE_SIZE)));
+            setBlocks(nullptr);
+        }
+    }
 
-            auto data = new T[max_count * aligned_block_size];
+    // another number of blocks, empty; neither producer nor consumer may be active
+    void setCount(int count)
+    {
+        if (count == max_count)
+            return;
 
-            for (int i = 0; i < max_count; ++i)
-            {
-                buffers[i] = &data[i * aligned_block_size];
-            }
+        freeData();
+        delete[] buffers;
+        resize(count);
+        buffers = new TPtr[max_count];
+        buffers[0] = nullptr;
+        if (block_size)
+        {
+            data = static_cast<T*>(::operator new[](sizeof(T) * max_count * alignedBlockSize(),
+                std::align_val_t(CACHELINE_SIZE)));
+            setBlocks(nullptr);
+        }
+        Reset();
+    }
+
+    // use getCount() blocks of getBlockSize(), which are allocated outside
+    // (e.g. USB transfer buffers) - or the own blocks again with nullptr
+    void setBlocks(T* const* blocks)
+    {
+        for (int i = 0; i < max_count; ++i)
+        {
+            buffers[i] = blocks ? blocks[i] : &data[i * alignedBlockSize()];
         }
     }
 
     T* peekWritePtr(int offset)
     {
-        return buffers[(write_index + max_count + offset) % max_count];
+        return buffers[(write_index.load(std::memory_order_relaxed) + max_count + offset) % max_count];
     }
 
     T* peekReadPtr(int offset)
     {
-        return buffers[(read_index + max_count + offset) % max_count];
+        return buffers[(read_index.load(std::memory_order_relaxed) + max_count + offset) % max_count];
+    }
+
+    // for producers, that must not wait: nullptr, if the ring is full
+    T* tryWritePtr()
+    {
+        if (filled() >= max_count - 1)
+            return nullptr;
+        return buffers[write_index.load(std::memory_order_relaxed)];
+    }
+
+    // overflow_drop_oldest, for producers that must not wait: a copy of block goes
+    //   in, also with the ring full. then the queued blocks go stale (see
+    //   DiscardQueued()) and the new one waits aside, until the consumer skipped
+    //   them: the next call, or FlushPending(), moves it in. a newer block replaces
+    //   the one waiting, which is lost
+    void WriteDropOldest(const T* block)
+    {
+        T* ptr = FlushPending() ? tryWritePtr() : nullptr;
+        if (ptr != nullptr)
+        {
+            memcpy(ptr, block, block_size * sizeof(T));
+            WriteDone();
+            return;
+        }
+
+        if (pendingValid)
+            Lost();
+        pending.resize(block_size);
+        memcpy(pending.data(), block, block_size * sizeof(T));
+        pendingValid = true;
+        pendingSequence = writeSequence;
+        pendingTime = Now();
+        DiscardQueued();
+    }
+
+    // the block waiting aside in, if there is room by now; false if not
+    bool FlushPending()
+    {
+        if (!pendingValid)
+            return true;
+        T* ptr = tryWritePtr();
+        if (ptr == nullptr)
+            return false;
+        memcpy(ptr, pending.data(), block_size * sizeof(T));
+        pendingValid = false;
+        WriteDone(pendingSequence, pendingTime);
+        return true;
     }
 
     T* getWritePtr()
     {
         // if there is still space
         WaitUntilNotFull();
-        return buffers[(write_index) % max_count];
+        return buffers[write_index.load(std::memory_order_relaxed)];
     }
 
+    // skips stale blocks first (see DiscardQueued())
     const T* getReadPtr()
     {
+        Discard();
         WaitUntilNotEmpty();
 
-        return buffers[read_index];
+        return buffers[read_index.load(std::memory_order_relaxed)];
+    }
+
+    // like getWritePtr()/getReadPtr(), but for the block 'offset' ahead;
+    // lets several consumers/producers work on consecutive blocks, which
+    // still have to be completed in order with WriteDone()/ReadDone()
+    T* getWritePtr(int offset)
+    {
+        WaitUntilNotFull(offset);
+        return buffers[(write_index.load(std::memory_order_relaxed) + offset) % max_count];
+    }
+
+    const T* getReadPtr(int offset)
+    {
+        WaitUntilNotEmpty(offset);
+        return buffers[(read_index.load(std::memory_order_relaxed) + offset) % max_count];
     }
 
     int getBlockSize() const { return block_size; }
 
 private:
+    int alignedBlockSize() const
+    {
+        const int line = int(CACHELINE_SIZE / sizeof(T));
+        const int align = line > ALIGN ? line : ALIGN;
+        return (block_size + align - 1) & (~(align - 1));
+    }
+
+    void freeData()
+    {
+        if (data)
+            ::operator delete[](data, std::align_val_t(CACHELINE_SIZE));
+        data = nullptr;
+    }
+
     int block_size;
+    T* data;
 
     TPtr* buffers;
+    std::vector<T> pending;     // see WriteDropOldest()
 };
\ No newline at end of file
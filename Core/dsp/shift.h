@@ -0,0 +1,109 @@
+#pragma once
+
+// the per channel steps of the DDC between the forward and the inverse fft:
+//  shift (and mirror) the tuned bins, times the filter's spectrum, and after
+//  the inverse fft copy out and fine tune
+//
+// like convert.h: compiled into each per-ISA translation unit of the r2iq
+// threads with its instruction set, so all functions have internal linkage -
+// as inline class members the linker would keep any one of the copies, which
+// might be the AVX-512 one on a cpu without.
+
+#include "fftw3.h"
+#include "../pffft/pf_mixer.h"
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// besides circular shift, do complex multiplication with the lowpass filter's spectrum
+//   dest[offset + m] = source1[m] * source2[m] * rot, for m in [start, end)
+//   flip mirrors the spectrum for the lower sideband: dest[-(offset + m) mod mfft]
+//   gets the conjugate, which is the same as negating Q after the inverse fft
+template<bool flip> static inline void shift_freq(fftwf_complex* dest, int offset, int mask, const fftwf_complex* source1, const fftwf_complex* source2, int start, int end, const float* rot)
+{
+    for (int m = start; m < end; m++)
+    {
+        const int d = flip ? (-(offset + m)) & mask : offset + m;
+        const float i = source1[m][0] * source2[m][0] - source1[m][1] * source2[m][1];
+        const float q = source1[m][1] * source2[m][0] + source1[m][0] * source2[m][1];
+        dest[d][0] = i * rot[0] - q * rot[1];
+        const float qr = q * rot[0] + i * rot[1];
+        dest[d][1] = flip ? -qr : qr;
+    }
+}
+
+// phase correction for the circular shift by 'tunebin' bins of the k-th fft of input buffer seq
+//   (of 'samples'): fft k starts samples * seq + (3 * halfFft / 2) * k - halfFft samples into the stream;
+//   shifting by tunebin bins of the 2 * halfFft fft leaves a phase of 2 pi tunebin * start / (2 * halfFft),
+//   which is a multiple of a quarter turn - and none at all for tunebin % 4 == 0
+static inline const float* binPhase(int tunebin, int k, uint64_t seq, int samples, int halfFft)
+{
+    static const float quarter[4][2] = { { 1.0f, 0.0f }, { 0.0f, -1.0f }, { -1.0f, 0.0f }, { 0.0f, 1.0f } };
+    const int quarters = int((seq * (2 * samples / halfFft)) & 3) + 3 * k - 2;
+    return quarter[(tunebin * quarters) & 3];
+}
+
+template<bool flip> static inline void zero_freq(fftwf_complex* dest, int offset, int mask, int start, int end)
+{
+    if (!flip)
+    {
+        memset(dest[offset + start], 0, sizeof(float) * 2 * (end - start));
+        return;
+    }
+    for (int m = start; m < end; m++)
+    {
+        const int d = (-(offset + m)) & mask;
+        dest[d][0] = dest[d][1] = 0.0f;
+    }
+}
+
+// circular shift tune fs/2 both halves into dest[] (of mfft), mirrored for the lower sideband
+template<bool flip> static inline void shift_bins(fftwf_complex* dest, int mfft,
+    const fftwf_complex* source, const fftwf_complex* filter, int count,
+    const fftwf_complex* source2, const fftwf_complex* filter2, int start, const float* rot)
+{
+    shift_freq<flip>(dest, 0, mfft - 1, source, filter, 0, count, rot);
+    if (mfft / 2 != count)
+        zero_freq<flip>(dest, 0, mfft - 1, count, mfft / 2);
+
+    shift_freq<flip>(dest, mfft / 2, mfft - 1, source2, filter2, start, mfft / 2, rot);
+    if (start != 0)
+        zero_freq<flip>(dest, mfft / 2, mfft - 1, 0, start);
+}
+
+// mix with fc (relative to the output rate), phase continuous over the output stream:
+//   the start phase is taken from the position n of data[0] in the stream,
+//   so the threads can do it for their part independently
+static inline void fine_tune(fftwf_complex* data, int count, float fc, shift_limited_unroll_C_sse_data_t* state, uint64_t n)
+{
+    const double pi2 = 2.0 * 3.14159265358979323846;
+    for (int i = 0; i < PF_SHIFT_LIMITED_SIMD_SZ; i++)
+    {
+        double cycles = (double)fc * (double)(n + i);
+        cycles -= floor(cycles);
+        state->phase_state_i[i] = (float)cos(pi2 * cycles);
+        state->phase_state_q[i] = (float)sin(pi2 * cycles);
+    }
+    shift_limited_unroll_C_sse_inp_c((complexf*)data, count, state);
+}
+
+// copy out of the inverse fft, Q negated for flip
+template<bool flip> static inline void copy_iq(fftwf_complex* dest, const fftwf_complex* source, int count)
+{
+    if (flip)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            dest[i][0] = source[i][0];
+            dest[i][1] = -source[i][1];
+        }
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+        {
+            dest[i][0] = source[i][0];
+            dest[i][1] = source[i][1];
+        }
+    }
+}
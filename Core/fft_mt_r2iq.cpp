@@ -17,11 +17,14 @@ The name r2iq as Real 2 I+Q stream
 #include "fftw3.h"
 #include "RadioHandler.h"
 
-#include "fir.h"
+#include "fftw_cache.h"
 
 #include <assert.h>
+#include <chrono>
 #include <utility>
 
+using namespace std::chrono;
+
 
 r2iqControlClass::r2iqControlClass()
 {
@@ -38,30 +41,43 @@ r2iqControlClass::r2iqControlClass()
 
 fft_mt_r2iq::fft_mt_r2iq() :
 	r2iqControlClass(),
-	filterHw(nullptr)
+	fftSizeAuto(true),
+	builtHalfFft(0),
+	setupTime(0.0f),
+	spectrumCallback(nullptr),
+	spectrumContext(nullptr),
+	spectrumBins(0),
+	spectrumFrames(0),
+	spectrumInterval(1),
+	spectrumAverage(0),
+	spectrumGroup(1),
+	inputTap(nullptr),
+	inputTapContext(nullptr),
+	processor_count(0),
+	simdLevel(SIMD_AUTO)
 {
-	mtunebin = halfFft / 4;
-	mfftdim[0] = halfFft;
-	for (int i = 1; i < NDECIDX; i++)
+	for (int d = 0; d < NDECIDX; d++)
+		plans_f2t_c2c[d] = nullptr;
+	for (int t = 0; t < N_MAX_R2IQ_THREADS; t++)
+		threadArgs[t] = nullptr;
+	for (int c = 0; c < NDDCCHANNELS; c++)
 	{
-		mfftdim[i] = mfftdim[i - 1] / 2;
+		channels[c].outputbuffer = nullptr;
+		channels[c].decimate = 0;
+		channels[c].offset = 0.25f;
+		channels[c].firstSequence = 0;
+		channels[c].firstTime = 0;
 	}
 	GainScale = 0.0f;
+	setFftSize(0);
 
 #ifndef NDEBUG
-	int mratio = 1;  // 1,2,4,8,16,..
-	const float Astop = 120.0f;
-	const float relPass = 0.85f;  // 85% of Nyquist should be usable
-	const float relStop = 1.1f;   // 'some' alias back into transition band is OK
 	printf("\n***************************************************************************\n");
-	printf("Filter tap estimation, Astop = %.1f dB, relPass = %.2f, relStop = %.2f\n", Astop, relPass, relStop);
+	printf("Filter taps for the stopband (see filter_bank.h)\n");
 	for (int d = 0; d < NDECIDX; d++)
 	{
-		float Bw = 64.0f / mratio;
-		int ntaps = KaiserWindow(0, Astop, relPass * Bw / 128.0f, relStop * Bw / 128.0f, nullptr);
-		printf("decimation %2d: KaiserWindow(Astop = %.1f dB, Fpass = %.3f,Fstop = %.3f, Bw %.3f @ %f ) => %d taps\n",
-			d, Astop, relPass * Bw, relStop * Bw, Bw, 128.0f, ntaps);
-		mratio = mratio * 2;
+		int ntaps = DecimationFilterTaps(d);
+		printf("decimation %2d: %5d taps => fft size %d and up\n", d, ntaps, fftSizeFor(ntaps));
 	}
 	printf("***************************************************************************\n");
 #endif
@@ -70,48 +86,206 @@ fft_mt_r2iq::fft_mt_r2iq() :
 
 fft_mt_r2iq::~fft_mt_r2iq()
 {
-	if (filterHw == nullptr)
-		return;
+	if (builtHalfFft != 0)
+		FreeFft();
 
-	fftwf_export_wisdom_to_filename("wisdom");
+	for (unsigned t = 0; t < N_MAX_R2IQ_THREADS; t++)
+		delete threadArgs[t];
+}
 
+void fft_mt_r2iq::FreeFft()
+{
 	for (int d = 0; d < NDECIDX; d++)
-	{
-		fftwf_free(filterHw[d]);     // 4096
-	}
-	fftwf_free(filterHw);
+		filters[d].reset();
 
-	fftwf_destroy_plan(plan_t2f_r2c);
-	for (int d = 0; d < NDECIDX; d++)
 	{
-		fftwf_destroy_plan(plans_f2t_c2c[d]);
+		std::lock_guard<std::mutex> lk(FftwPlannerLock());
+		fftwf_destroy_plan(plan_t2f_r2c);
+		for (int d = 0; d < NDECIDX; d++)
+		{
+			if (plans_f2t_c2c[d])
+				fftwf_destroy_plan(plans_f2t_c2c[d]);
+			plans_f2t_c2c[d] = nullptr;
+		}
 	}
 
-	for (unsigned t = 0; t < processor_count; t++) {
+	for (unsigned t = 0; t < N_MAX_R2IQ_THREADS; t++) {
 		auto th = threadArgs[t];
 		fftwf_free(th->ADCinTime);
 		fftwf_free(th->ADCinFreq);
 		fftwf_free(th->inFreqTmp);
+		fftwf_free(th->outTmp);
+		fftwf_free(th->power);
+	}
+	builtHalfFft = 0;
+}
 
-		delete threadArgs[t];
+bool fft_mt_r2iq::setFftSize(int size)
+{
+	if (this->r2iqOn)
+		return false;
+
+	if (size == 0)
+	{
+		this->fftSizeAuto = true;
+		resize(getFftSize());
+		return true;
 	}
+
+	// each fft adds 3/4 of its inverse's size to the output: only with these sizes
+	//   an output block (EXT_BLOCKLEN) is exactly 2^decimate input buffers' output
+	int valid = 2048;
+	while (valid < size && valid < 2 * (int)transferSamples)
+		valid *= 4;
+	if (size != valid || size > 2 * (int)transferSamples)
+		return false;
+
+	this->fftSizeAuto = false;
+	resize(size);
+	return true;
 }
 
+int fft_mt_r2iq::getFftSize() const
+{
+	if (!this->fftSizeAuto || this->r2iqOn)
+		return 2 * halfFft;
+
+	// the longest filter of the channels in use
+	int taps = 0;
+	for (int c = 0; c < NDDCCHANNELS; c++)
+	{
+		if (channels[c].outputbuffer)
+			taps = std::max(taps, DecimationFilterTaps(c == 0 ? this->mdecimation : channels[c].decimate));
+	}
+	return fftSizeFor(taps);
+}
+
+// the smallest fft, whose overlap has room for a filter of taps
+int fft_mt_r2iq::fftSizeFor(int taps)
+{
+	int size = 2048;
+	while (size / 8 + 1 < taps && size < 2 * (int)transferSamples)
+		size *= 4;
+	return size;
+}
+
+void fft_mt_r2iq::resize(int size)
+{
+	halfFft = size / 2;
+	fftPerBuf = transferSamples / (3 * halfFft / 2) + 1;
+	mfftdim[0] = halfFft;
+	for (int i = 1; i < NDECIDX; i++)
+	{
+		mfftdim[i] = mfftdim[i - 1] / 2;
+	}
+
+	// the bins move with the size
+	for (int c = 0; c < NDDCCHANNELS; c++)
+		tuneBin(channels[c]);
+}
 
 float fft_mt_r2iq::setFreqOffset(float offset)
 {
-	// align to 1/4 of halfft
-	this->mtunebin = int(offset * halfFft / 4) * 4;  // mtunebin step 4 bin  ?
-	float delta = ((float)this->mtunebin  / halfFft) - offset;
-	float ret = delta * getRatio(); // ret increases with higher decimation
-	DbgPrintf("offset %f mtunebin %d delta %f (%f)\n", offset, this->mtunebin, delta, ret);
+	return setChannelFreqOffset(0, offset);
+}
+
+void fft_mt_r2iq::tuneBin(r2iqChannel& ch)
+{
+	// nearest bin: the threads correct the phase of odd bins (see binPhase())
+	ch.tunebin = std::min(std::max(int(ch.offset * halfFft + 0.5f), 0), halfFft);
+	ch.finetune = ((float)ch.tunebin / halfFft) - ch.offset;   // mixed in by the threads, with the output rate
+}
+
+float fft_mt_r2iq::setChannelFreqOffset(int channel, float offset)
+{
+	if (channel < 0 || channel >= NDDCCHANNELS)
+		return 0.0f;
+
+	r2iqChannel& ch = this->channels[channel];
+	ch.offset = offset;
+	tuneBin(ch);
+	float delta = ch.finetune;
+	const int decimate = (channel == 0) ? this->mdecimation : ch.decimate;
+	float ret = delta * mratio[decimate]; // ret increases with higher decimation
+	DbgPrintf("channel %d offset %f tunebin %d delta %f (%f)\n", channel, offset, ch.tunebin, delta, ret);
 	return ret;
 }
 
+int fft_mt_r2iq::AddChannel(ringbuffer<float>* obuffers, int dec)
+{
+	if (this->r2iqOn || dec < 0 || dec >= NDECIDX)
+		return -1;
+
+	for (int c = 1; c < NDDCCHANNELS; c++)
+	{
+		r2iqChannel& ch = this->channels[c];
+		if (ch.outputbuffer == nullptr)
+		{
+			ch.outputbuffer = obuffers;
+			ch.decimate = dec;
+			// fs/4, until tuned: none of the last user's tuning, which a
+			//   change of the fft size would bring back (see resize())
+			ch.offset = 0.25f;
+			tuneBin(ch);
+			return c;
+		}
+	}
+	return -1;
+}
+
+void fft_mt_r2iq::RemoveChannel(int channel)
+{
+	if (this->r2iqOn || channel < 1 || channel >= NDDCCHANNELS)
+		return;
+
+	this->channels[channel].outputbuffer = nullptr;
+}
+
 void fft_mt_r2iq::TurnOn() {
+	auto start = steady_clock::now();
+	if (this->fftSizeAuto)
+		resize(getFftSize());
+	if (this->builtHalfFft != this->halfFft)
+		BuildFft();     // the fft size changed
+
+	// plans for the decimations in use only
+	this->channels[0].decimate = this->mdecimation;
+	bool planned = false;
+	for (int c = 0; c < NDDCCHANNELS; c++)
+	{
+		if (channels[c].outputbuffer)
+			planned |= PlanDecimation(channels[c].decimate);
+	}
+	if (planned)
+	{
+		std::lock_guard<std::mutex> lk(FftwPlannerLock());
+		WisdomSave();
+	}
+	if (spectrumCallback)
+	{
+		// there are only so many ffts in an interval
+		spectrumGroup = std::max(1, halfFft / spectrumBins);
+		spectrumAverage = std::min(spectrumFrames, spectrumInterval * fftPerBuf);
+		if (spectrumAverage != spectrumFrames)
+			DbgPrintf("r2iq spectrum: %d ffts per spectrum, not %d\n", spectrumAverage, spectrumFrames);
+		for (int i = 0; i < N_R2IQ_WINDOW; i++)
+		{
+			spectra[i].power.assign(halfFft / spectrumGroup, 0.0f);
+			spectra[i].frames = 0;
+		}
+	}
+	this->setupTime = duration<float, std::milli>(steady_clock::now() - start).count();
+	if (this->setupTime >= 1.0f)
+		DbgPrintf("r2iq setup %.1f ms\n", this->setupTime);
+
 	this->r2iqOn = true;
-	this->bufIdx = 0;
-	this->lastThread = threadArgs[0];
+	this->seqReserved = 0;
+	this->seqDone = 0;
+	this->blockTime.Reset();
+	this->seqWaiting = false;
+	this->seqReadPending = 0;
+	for (int i = 0; i < N_R2IQ_WINDOW; i++)
+		this->seqFinished[i] = false;
 
 	for (unsigned t = 0; t < processor_count; t++) {
 		r2iq_thread[t] = std::thread(
@@ -124,94 +298,181 @@ void fft_mt_r2iq::TurnOff(void) {
 	this->r2iqOn = false;
 
 	inputbuffer->Stop();
-	outputbuffer->Stop();
+	for (int c = 0; c < NDDCCHANNELS; c++)
+	{
+		if (channels[c].outputbuffer)
+			channels[c].outputbuffer->Stop();
+	}
+	{
+		std::unique_lock<std::mutex> lk(mutexR2iqControl);
+		seqWindowCV.notify_all();
+	}
 	for (unsigned t = 0; t < processor_count; t++) {
 		r2iq_thread[t].join();
 	}
 }
 
-bool fft_mt_r2iq::IsOn(void) { return(this->r2iqOn); }
+bool fft_mt_r2iq::setSpectrum(int bins, int frames, int interval, r2iqSpectrumCb callback, void* context)
+{
+	if (this->r2iqOn || (callback && (bins < 1 || (bins & (bins - 1)) || frames < 1 || interval < 1)))
+		return false;
+
+	this->spectrumCallback = callback;
+	this->spectrumContext = context;
+	this->spectrumBins = bins;
+	this->spectrumFrames = frames;
+	this->spectrumInterval = interval;
+	return true;
+}
 
-void fft_mt_r2iq::Init(float gain, ringbuffer<int16_t> *input, ringbuffer<float>* obuffers)
+bool fft_mt_r2iq::setInputTap(r2iqInputTap callback, void* context)
 {
-	this->inputbuffer = input;    // set to the global exported by main_loop
-	this->outputbuffer = obuffers;  // set to the global exported by main_loop
+	std::lock_guard<std::mutex> lk(mutexInputTap);
+	this->inputTap = callback;
+	this->inputTapContext = context;
+	return true;
+}
 
-	this->GainScale = gain;
+// sum up the power of an input buffer's ffts into its spectrum
+void fft_mt_r2iq::addSpectrum(r2iqThreadArg* th, uint64_t seq, int ffts)
+{
+	// bins of the ffts to bins of the spectrum, in place: bin b reads from b * group on
+	const int group = spectrumGroup;
+	const int bins = halfFft / group;
+	if (group > 1)
+	{
+		for (int b = 0; b < bins; b++)
+		{
+			float sum = 0.0f;
+			for (int g = 0; g < group; g++)
+				sum += th->power[b * group + g];
+			th->power[b] = sum;
+		}
+	}
 
-	fftwf_import_wisdom_from_filename("wisdom");
+	{
+		std::lock_guard<std::mutex> lk(mutexSpectrum);
+		auto& spectrum = spectra[(seq / spectrumInterval) % N_R2IQ_WINDOW];
+		for (int b = 0; b < bins; b++)
+			spectrum.power[b] += th->power[b];
+		spectrum.frames += ffts;
+		if (spectrum.frames < spectrumAverage)
+			return;
+
+		// complete: the mean, normalized to the fft size, goes out of th->power
+		const float scale = 1.0f / ((float)spectrumAverage * 4.0f * (float)halfFft * (float)halfFft);
+		for (int b = 0; b < bins; b++)
+		{
+			th->power[b] = spectrum.power[b] * scale;
+			spectrum.power[b] = 0.0f;
+		}
+		spectrum.frames = 0;
+	}
+	spectrumCallback(spectrumContext, th->power, bins);
+}
 
-	// Get the processor count
-	processor_count = std::thread::hardware_concurrency() - 1;
-	if (processor_count == 0)
-		processor_count = 1;
-	if (processor_count > N_MAX_R2IQ_THREADS)
-		processor_count = N_MAX_R2IQ_THREADS;
+bool fft_mt_r2iq::IsOn(void) { return(this->r2iqOn); }
 
+// called with mutexR2iqControl locked
+void fft_mt_r2iq::completeSeq(uint64_t seq)
+{
+	seqFinished[seq % N_R2IQ_WINDOW] = true;
+
+	// release input and hand over output buffers in order,
+	//   as far as all previous input buffers are processed
+	while (seqDone < seqReserved && seqFinished[seqDone % N_R2IQ_WINDOW])
 	{
-		fftwf_plan filterplan_t2f_c2c; // time to frequency fft
+		seqFinished[seqDone % N_R2IQ_WINDOW] = false;
+		const int offset = seqWaiting ? seqReadPending : 0;
+		const uint64_t sequence = inputbuffer->getReadSequence(offset);
+		for (int c = 0; c < NDDCCHANNELS; c++)
+		{
+			// each channel's output block is complete after 2^decimate input buffers,
+			//   it goes with the stamp of the first one
+			r2iqChannel& ch = channels[c];
+			const uint64_t decimate_mask = (1 << ch.decimate) - 1;
+			if (ch.outputbuffer == nullptr)
+				continue;
+			if ((seqDone & decimate_mask) == 0)
+			{
+				ch.firstSequence = sequence;
+				ch.firstTime = inputbuffer->getReadTime(offset);
+			}
+			if ((seqDone & decimate_mask) == decimate_mask)
+				ch.outputbuffer->WriteDone(ch.firstSequence, ch.firstTime);
+		}
+		if (seqWaiting)
+			seqReadPending++;
+		else
+			inputbuffer->ReadDone();
+		seqDone++;
+	}
+	seqWindowCV.notify_all();
+}
 
-		DbgPrintf((char *) "r2iqCntrl initialization\n");
+void fft_mt_r2iq::Init(float gain, ringbuffer<int16_t> *input, ringbuffer<float>* obuffers)
+{
+	this->inputbuffer = input;    // set to the global exported by main_loop
+	this->channels[0].outputbuffer = obuffers;  // set to the global exported by main_loop
 
+	this->GainScale = gain;
+
+	auto start = steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lk(FftwPlannerLock());
+		WisdomLoad();
+	}
 
-		//        DbgPrintf((char *) "RandTable generated\n");
+	setThreads(0);
 
-		   // filters
-		fftwf_complex *pfilterht;       // time filter ht
-		pfilterht = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex)*halfFft);     // halfFft
-		filterHw = (fftwf_complex**)fftwf_malloc(sizeof(fftwf_complex*)*NDECIDX);
-		for (int d = 0; d < NDECIDX; d++)
-		{
-			filterHw[d] = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex)*halfFft);     // halfFft
-		}
+	// for all threads setThreads() might ask for
+	for (unsigned t = 0; t < N_MAX_R2IQ_THREADS; t++)
+		threadArgs[t] = new r2iqThreadArg();
 
-		filterplan_t2f_c2c = fftwf_plan_dft_1d(halfFft, pfilterht, filterHw[0], FFTW_FORWARD, FFTW_MEASURE);
-		float *pht = new float[halfFft / 4 + 1];
-		const float Astop = 120.0f;
-		const float relPass = 0.85f;  // 85% of Nyquist should be usable
-		const float relStop = 1.1f;   // 'some' alias back into transition band is OK
-		for (int d = 0; d < NDECIDX; d++)	// @todo when increasing NDECIDX
-		{
-			// @todo: have dynamic bandpass filter size - depending on decimation
-			//   to allow same stopband-attenuation for all decimations
-			float Bw = 64.0f / mratio[d];
-			// Bw *= 0.8f;  // easily visualize Kaiser filter's response
-			KaiserWindow(halfFft / 4 + 1, Astop, relPass * Bw / 128.0f, relStop * Bw / 128.0f, pht);
+	BuildFft();
+	this->setupTime = duration<float, std::milli>(steady_clock::now() - start).count();
+	DbgPrintf("r2iq init %.1f ms\n", this->setupTime);
+}
 
-			float gainadj = gain * 2048.0f / (float)FFTN_R_ADC; // reference is FFTN_R_ADC == 2048
+// the filter and the inverse fft of decimation d, when it is used the first time;
+//   true if newly planned
+bool fft_mt_r2iq::PlanDecimation(int d)
+{
+	if (!filters[d])
+		filters[d] = GetDecimationFilter(GainScale, halfFft, d);
+	if (plans_f2t_c2c[d])
+		return false;
+
+	std::lock_guard<std::mutex> lk(FftwPlannerLock());
+	plans_f2t_c2c[d] = fftwf_plan_dft_1d(mfftdim[d], threadArgs[0]->inFreqTmp, threadArgs[0]->outTmp, FFTW_BACKWARD, FFTW_MEASURE);
+	return true;
+}
 
-			for (int t = 0; t < halfFft; t++)
-			{
-				pfilterht[t][0] = pfilterht[t][1]= 0.0F;
-			}
-		
-			for (int t = 0; t < (halfFft/4+1); t++)
-			{
-				pfilterht[halfFft-1-t][0] = gainadj * pht[t];
-			}
+// plans and thread buffers for halfFft; the filters follow with the inverse ffts
+void fft_mt_r2iq::BuildFft()
+{
+	if (builtHalfFft != 0)
+		FreeFft();
 
-			fftwf_execute_dft(filterplan_t2f_c2c, pfilterht, filterHw[d]);
-		}
-		delete[] pht;
-		fftwf_destroy_plan(filterplan_t2f_c2c);
-		fftwf_free(pfilterht);
+	{
+		DbgPrintf((char *) "r2iqCntrl initialization\n");
 
-		for (unsigned t = 0; t < processor_count; t++) {
-			r2iqThreadArg *th = new r2iqThreadArg();
-			threadArgs[t] = th;
+		for (unsigned t = 0; t < N_MAX_R2IQ_THREADS; t++) {
+			r2iqThreadArg *th = threadArgs[t];
 
-			th->ADCinTime = (float*)fftwf_malloc(sizeof(float) * (halfFft + transferSize / 2));                 // 2048
+			th->ADCinTime = (float*)fftwf_malloc(sizeof(float) * 2 * halfFft);   // window of one fft
 
 			th->ADCinFreq = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex)*(halfFft + 1)); // 1024+1
 			th->inFreqTmp = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex)*(halfFft));    // 1024
+			th->outTmp = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex)*(halfFft));    // 1024
+			th->power = (float*)fftwf_malloc(sizeof(float)*(halfFft));    // 1024
 		}
 
+		// the inverse ffts follow in TurnOn(), for the decimations in use
+		std::lock_guard<std::mutex> lk(FftwPlannerLock());
 		plan_t2f_r2c = fftwf_plan_dft_r2c_1d(2 * halfFft, threadArgs[0]->ADCinTime, threadArgs[0]->ADCinFreq, FFTW_MEASURE);
-		for (int d = 0; d < NDECIDX; d++)
-		{
-			plans_f2t_c2c[d] = fftwf_plan_dft_1d(mfftdim[d], threadArgs[0]->inFreqTmp, threadArgs[0]->inFreqTmp, FFTW_BACKWARD, FFTW_MEASURE);
-		}
 	}
+	builtHalfFft = halfFft;
 }
 
 #ifdef _WIN32
@@ -237,11 +498,28 @@ void fft_mt_r2iq::Init(float gain, ringbuffer<int16_t> *input, ringbuffer<float>
 #error Compiler does not identify an x86 or ARM core..
 #endif
 
-void * fft_mt_r2iq::r2iqThreadf(r2iqThreadArg *th)
+void fft_mt_r2iq::setThreads(unsigned count)
+{
+	if (this->r2iqOn)
+		return;
+
+	if (count == 0)
+	{
+		// Get the processor count
+		count = std::thread::hardware_concurrency() - 1;
+		if (count == 0)
+			count = 1;
+	}
+	processor_count = std::min<unsigned>(count, N_MAX_R2IQ_THREADS);
+}
+
+typedef fft_mt_r2iq::SimdLevel SimdLevel;
+
+static SimdLevel detect_simd()
 {
 #ifdef NO_SIMD_OPTIM
 	DbgPrintf("Hardware Capability: all SIMD features (AVX, AVX2, AVX512) deactivated\n");
-	return r2iqThreadf_def(th);
+	return fft_mt_r2iq::SIMD_DEF;
 #else
 #if defined(DETECT_AVX)
 	int info[4];
@@ -266,20 +544,94 @@ void * fft_mt_r2iq::r2iqThreadf(r2iqThreadArg *th)
 	DbgPrintf("Hardware Capability: AVX:%d AVX2:%d AVX512:%d\n", HW_AVX, HW_AVX2, HW_AVX512F);
 
 	if (HW_AVX512F)
-		return r2iqThreadf_avx512(th);
+		return fft_mt_r2iq::SIMD_AVX512;
 	else if (HW_AVX2)
-		return r2iqThreadf_avx2(th);
+		return fft_mt_r2iq::SIMD_AVX2;
 	else if (HW_AVX)
-		return r2iqThreadf_avx(th);
+		return fft_mt_r2iq::SIMD_AVX;
 	else
-		return r2iqThreadf_def(th);
+		return fft_mt_r2iq::SIMD_DEF;
 #elif defined(DETECT_NEON)
 	bool NEON = detect_neon();
 	DbgPrintf("Hardware Capability: NEON:%d\n", NEON);
 	if (NEON)
-		return r2iqThreadf_neon(th);
+		return fft_mt_r2iq::SIMD_NEON;
 	else
-		return r2iqThreadf_def(th);
+		return fft_mt_r2iq::SIMD_DEF;
+#endif
+#endif
+}
+
+bool fft_mt_r2iq::isSimdSupported(SimdLevel level)
+{
+	if (level == SIMD_AUTO || level == SIMD_DEF)
+		return true;
+
+	const SimdLevel detected = detect_simd();
+#if defined(DETECT_AVX) && !defined(NO_SIMD_OPTIM)
+	// each x86 level includes the ones below
+	return level != SIMD_NEON && detected != SIMD_NEON && level <= detected;
+#else
+	return level == detected;
+#endif
+}
+
+const char* fft_mt_r2iq::getSimdName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_AUTO:
+		return "auto";
+	case SIMD_AVX:
+		return "avx";
+	case SIMD_AVX2:
+		return "avx2";
+	case SIMD_AVX512:
+		return "avx512";
+	case SIMD_NEON:
+		return "neon";
+	default:
+		return "def";
+	}
+}
+
+void * fft_mt_r2iq::r2iqThreadf(r2iqThreadArg *th)
+{
+	tracer::SetThreadName("r2iq");
+	switch (simdLevel == SIMD_AUTO ? detect_simd() : simdLevel)
+	{
+#if defined(DETECT_AVX) && !defined(NO_SIMD_OPTIM)
+	case SIMD_AVX512:
+		return r2iqThreadf_avx512(th);
+	case SIMD_AVX2:
+		return r2iqThreadf_avx2(th);
+	case SIMD_AVX:
+		return r2iqThreadf_avx(th);
+#elif defined(DETECT_NEON) && !defined(NO_SIMD_OPTIM)
+	case SIMD_NEON:
+		return r2iqThreadf_neon(th);
 #endif
+	default:
+		return r2iqThreadf_def(th);
+	}
+}
+
+fft_mt_r2iq::convert_float_t fft_mt_r2iq::getConvertFloat()
+{
+	switch (detect_simd())
+	{
+#if defined(DETECT_AVX) && !defined(NO_SIMD_OPTIM)
+	case SIMD_AVX512:
+		return convert_float_avx512;
+	case SIMD_AVX2:
+		return convert_float_avx2;
+	case SIMD_AVX:
+		return convert_float_avx;
+#elif defined(DETECT_NEON) && !defined(NO_SIMD_OPTIM)
+	case SIMD_NEON:
+		return convert_float_neon;
 #endif
+	default:
+		return convert_float_def;
+	}
 }
@@ -2,16 +2,23 @@
 
 #include "r2iq.h"
 #include "fftw3.h"
+#include "filter_bank.h"
 #include "config.h"
+#include "dsp/convert.h"
+#include "dsp/power.h"
+#include "dsp/shift.h"
+#include "pffft/pf_mixer.h"
+#include "tracer.h"
 #include <algorithm>
+#include <vector>
 #include <string.h>
 
 // use up to this many threads
-#define N_MAX_R2IQ_THREADS 1
+#define N_MAX_R2IQ_THREADS 4
+// max number of input buffers in work, before the oldest one is completed
+#define N_R2IQ_WINDOW (2 * N_MAX_R2IQ_THREADS)
 #define PRINT_INPUT_RANGE  0
 
-static const int halfFft = FFTN_R_ADC / 2;    // half the size of the first fft at ADC 64Msps real rate (2048)
-static const int fftPerBuf = transferSize / sizeof(short) / (3 * halfFft / 2) + 1; // number of ffts per buffer with 256|768 overlap
 
 class fft_mt_r2iq : public r2iqControlClass
 {
@@ -21,69 +28,118 @@ public:
 
     float setFreqOffset(float offset);
 
+    int AddChannel(ringbuffer<float>* obuffers, int dec);
+    void RemoveChannel(int channel);
+    float setChannelFreqOffset(int channel, float offset);
+
     void Init(float gain, ringbuffer<int16_t>* buffers, ringbuffer<float>* obuffers);
     void TurnOn();
     void TurnOff(void);
     bool IsOn(void);
 
-protected:
-
-    template<bool rand> void convert_float(const int16_t *input, float* output, int size)
-    {
-        for(int m = 0; m < size; m++)
-        {
-            int16_t val;
-            if (rand && (input[m] & 1))
-            {
-                val = input[m] ^ (-2);
-            }
-            else
-            {
-                val = input[m];
-            }
-            output[m] = float(val);
-        }
-    }
+    // int16 to float conversion kernel, picked by the same cpuid dispatch as the threads
+    typedef void (*convert_float_t)(const int16_t *input, float* output, int size, bool rand);
+    static convert_float_t getConvertFloat();
 
-    void shift_freq(fftwf_complex* dest, const fftwf_complex* source1, const fftwf_complex* source2, int start, int end)
+    // instruction set of the threads: detected from the cpu, unless forced (e.g. for benchmarks)
+    enum SimdLevel { SIMD_AUTO = -1, SIMD_DEF, SIMD_AVX, SIMD_AVX2, SIMD_AVX512, SIMD_NEON };
+    static bool isSimdSupported(SimdLevel level);
+    static const char* getSimdName(SimdLevel level);
+    bool setSimd(SimdLevel level)
     {
-        for (int m = start; m < end; m++)
-        {
-            // besides circular shift, do complex multiplication with the lowpass filter's spectrum
-            dest[m][0] = source1[m][0] * source2[m][0] - source1[m][1] * source2[m][1];
-            dest[m][1] = source1[m][1] * source2[m][0] + source1[m][0] * source2[m][1];
-        }
+        if (!isSimdSupported(level))
+            return false;
+        this->simdLevel = level;
+        return true;
     }
 
-    template<bool flip> void copy(fftwf_complex* dest, const fftwf_complex* source, int count)
-    {
-        if (flip)
-        {
-            for (int i = 0; i < count; i++)
-            {
-                dest[i][0] = source[i][0];
-                dest[i][1] = -source[i][1];
-            }
-        }
-        else
-        {
-            for (int i = 0; i < count; i++)
-            {
-                dest[i][0] = source[i][0];
-                dest[i][1] = source[i][1];
-            }
-        }
-    }
+    // number of threads from the next TurnOn() on, up to N_MAX_R2IQ_THREADS;
+    //   0: one less than the cpu cores
+    void setThreads(unsigned count);
+    unsigned getThreads() const { return processor_count; }
+
+    // size of the first (real) fft: 2 * 4^k from 2048 up to 2 * transferSamples;
+    //   only while turned off. the kernels and plans are built on the next TurnOn().
+    //   0, the default: the smallest one, whose overlap has room for the filters
+    //   of the decimations in use (see DecimationFilterTaps()), chosen in TurnOn()
+    bool setFftSize(int size);
+    int getFftSize() const;
+
+    // power spectrum of the input, out of the forward ffts the ddc does anyway: each
+    //   bin the mean |X[k]|^2 / (2 * halfFft)^2 of the first frames ffts of every interval
+    //   input buffers, summed up from halfFft to bins (a power of 2) from 0 to fs / 2.
+    //   the callback runs on the r2iq thread, that completes a spectrum; nullptr turns
+    //   it off. only while turned off
+    bool setSpectrum(int bins, int frames, int interval, r2iqSpectrumCb callback, void* context);
+
+    // the callback runs on the r2iq thread, that takes up the input buffer, before
+    //   its ffts: it holds up the next reservation and so must be quick, e.g. copy
+    //   the block and return
+    bool setInputTap(r2iqInputTap callback, void* context);
+
+    // ms the last Init() or TurnOn() took to design filters and plan ffts:
+    //   the startup cost, that cached fftw wisdom saves (see fftw_cache.h)
+    float getSetupTime() const { return setupTime; }
 
 private:
     ringbuffer<int16_t>* inputbuffer;    // pointer to input buffers
-    ringbuffer<float>* outputbuffer;    // pointer to ouput buffers
-    int bufIdx;         // index to next buffer to be processed
-    r2iqThreadArg* lastThread;
+
+    // input buffers are handed to the threads with increasing sequence number,
+    // completion is in the same order - independent of the thread finishing first
+    uint64_t seqReserved;    // sequence number of next input buffer to process
+    uint64_t seqDone;        // sequence number of oldest not completed input buffer
+    bool seqFinished[N_R2IQ_WINDOW];  // processing done, but not yet completed
+    std::condition_variable seqWindowCV;
+    std::mutex mutexR2iqReserve;   // one thread at a time waits for its input and output blocks
+    bool seqWaiting;         // .. and it does right now
+    int seqReadPending;      // completed input buffers, not yet ReadDone() as one is waiting
+    void completeSeq(uint64_t seq);
 
     float GainScale;
+    int halfFft;           // half the size of the first fft
+    bool fftSizeAuto;      // halfFft follows the decimations in use
+    int fftPerBuf;         // number of ffts per input buffer, with 1/4 overlap
     int mfftdim [NDECIDX]; // FFT N dimensions: mfftdim[k] = halfFft / 2^k
-    int mtunebin;
+    int builtHalfFft;      // halfFft of the plans and thread buffers; 0: none yet
+    float setupTime;       // ms the last Init() or TurnOn() took for filters and plans
+    static int fftSizeFor(int taps);
+    void resize(int size);
+    void BuildFft();
+    void FreeFft();
+    bool PlanDecimation(int d);
+
+    // ddc channels share the forward ffts, each does its own tune shift,
+    //   filter and inverse fft. channel 0 is the main output with mdecimation
+    struct r2iqChannel {
+        ringbuffer<float>* outputbuffer;  // nullptr: channel not in use
+        int decimate;
+        float offset;     // as set, for a change of the fft size
+        int tunebin;
+        float finetune;   // rest of the tuning offset below half a bin, relative to halfFft
+        uint64_t firstSequence;   // stamp of the first input buffer of the output block
+        uint64_t firstTime;       //   being filled, handed on with it (see completeSeq())
+    };
+    r2iqChannel channels[NDDCCHANNELS];
+    void tuneBin(r2iqChannel& ch);
+
+    r2iqSpectrumCb spectrumCallback;   // nullptr: no spectrum
+    void* spectrumContext;
+    int spectrumBins;      // as set
+    int spectrumFrames;    // as set
+    int spectrumInterval;  // input buffers per spectrum
+    int spectrumAverage;   // ffts per spectrum: frames, up to all of an interval
+    int spectrumGroup;     // bins of the ffts per bin of the spectrum
+    struct spectrumSum {
+        std::vector<float> power;
+        int frames;        // summed up so far
+    };
+    spectrumSum spectra[N_R2IQ_WINDOW];   // in progress, by seq / spectrumInterval
+    std::mutex mutexSpectrum;
+    void addSpectrum(r2iqThreadArg* th, uint64_t seq, int ffts);
+
+    r2iqInputTap inputTap;   // nullptr: none; with mutexInputTap
+    void* inputTapContext;
+    std::mutex mutexInputTap;  // the tap's copy runs without mutexR2iqControl
 
     void *r2iqThreadf(r2iqThreadArg *th);   // thread function
 
@@ -93,13 +149,19 @@ private:
     void * r2iqThreadf_avx512(r2iqThreadArg *th);
     void * r2iqThreadf_neon(r2iqThreadArg *th);
 
-    fftwf_complex **filterHw;       // Hw complex to each decimation ratio
+    static void convert_float_def(const int16_t *input, float* output, int size, bool rand);
+    static void convert_float_avx(const int16_t *input, float* output, int size, bool rand);
+    static void convert_float_avx2(const int16_t *input, float* output, int size, bool rand);
+    static void convert_float_avx512(const int16_t *input, float* output, int size, bool rand);
+    static void convert_float_neon(const int16_t *input, float* output, int size, bool rand);
+
+    std::shared_ptr<const FilterSpectrum> filters[NDECIDX];  // Hw complex of each decimation ratio in use
 
 	fftwf_plan plan_t2f_r2c;          // fftw plan buffers Freq to Time complex to complex per decimation ratio
-	fftwf_plan *plan_f2t_c2c;          // fftw plan buffers Time to Freq real to complex per buffer
-	fftwf_plan plans_f2t_c2c[NDECIDX];
+	fftwf_plan plans_f2t_c2c[NDECIDX]; // fftw plan buffers Time to Freq real to complex per buffer
 
-    uint32_t processor_count;
+    uint32_t processor_count;       // number of threads
+    SimdLevel simdLevel;
     r2iqThreadArg* threadArgs[N_MAX_R2IQ_THREADS];
     std::mutex mutexR2iqControl;                   // r2iq control lock
     std::thread r2iq_thread[N_MAX_R2IQ_THREADS]; // thread pointers
@@ -117,9 +179,11 @@ struct r2iqThreadArg {
 #endif
 	}
 
-	float *ADCinTime;                // point to each threads input buffers [nftt][n]
+	float *ADCinTime;                // each threads float input for one fft: 2 * halfFft
 	fftwf_complex *ADCinFreq;         // buffers in frequency
 	fftwf_complex *inFreqTmp;         // tmp decimation output buffers (after tune shift)
+	fftwf_complex *outTmp;            // inverse fft output (if not written directly)
+	float *power;                     // |ADCinFreq|^2 summed up over the ffts for the spectrum: halfFft
 #if PRINT_INPUT_RANGE
 	int MinMaxBlockCount;
 	int16_t MinValue;
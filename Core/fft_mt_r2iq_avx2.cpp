@@ -6,4 +6,12 @@
 void * fft_mt_r2iq::r2iqThreadf_avx2(r2iqThreadArg *th)
 {
     #include "fft_mt_r2iq_impl.hpp"
-}
\ No newline at end of file
+}
+
+void fft_mt_r2iq::convert_float_avx2(const int16_t *input, float* output, int size, bool rand)
+{
+    if (rand)
+        convert_float<true>(input, output, size);
+    else
+        convert_float<false>(input, output, size);
+}
@@ -1,59 +1,130 @@
 
 {
-	const int decimate = this->mdecimation;
-	const int mfft = this->mfftdim[decimate];	// = halfFft / 2^mdecimation
-	const fftwf_complex* filter = filterHw[decimate];
 	const bool lsb = this->getSideband();
-	const auto filter2 = &filter[halfFft - mfft / 2];
+	// new-array execute needs the alignment the plan was made with
+	const int alignment = fftwf_alignment_of((float*)th->outTmp);
 
-	plan_f2t_c2c = &plans_f2t_c2c[decimate];
-	fftwf_complex* pout = nullptr;
-	int decimate_count = 0;
+	// the channels in use, they don't change while turned on
+	struct {
+		const r2iqChannel* channel;
+		ringbuffer<float>* outputbuffer;
+		int decimate;
+		int mfft;	// = halfFft / 2^decimate
+		const fftwf_complex* filter;
+		const fftwf_complex* filter2;
+		uint64_t decimate_mask;
+		int outPerBuf;  // complex output samples per input buffer
+		fftwf_plan plan_f2t_c2c;
+
+		// per input buffer
+		fftwf_complex* pout;       // pointer to this input buffer's part of the output buffer
+		int tunebin;
+		int count;
+		int start;
+		float fc;
+
+		alignas(16) shift_limited_unroll_C_sse_data_t fineState;
+		float fineStateFc;
+	} chs[NDDCCHANNELS];
+	int nchs = 0;
+
+	for (int c = 0; c < NDDCCHANNELS; c++)
+	{
+		if (channels[c].outputbuffer == nullptr)
+			continue;
+
+		auto& ch = chs[nchs++];
+		ch.channel = &channels[c];
+		ch.outputbuffer = channels[c].outputbuffer;
+		ch.decimate = channels[c].decimate;
+		ch.mfft = this->mfftdim[ch.decimate];
+		ch.filter = filters[ch.decimate]->Hw;
+		ch.filter2 = &ch.filter[halfFft - ch.mfft / 2];
+		ch.decimate_mask = (1 << ch.decimate) - 1;
+		ch.outPerBuf = ch.mfft / 2 + (3 * ch.mfft / 4) * (fftPerBuf - 1);
+		ch.plan_f2t_c2c = plans_f2t_c2c[ch.decimate];
+		ch.fineStateFc = 0.0f;
+	}
 
 	while (r2iqOn) {
 		const int16_t *dataADC;  // pointer to input data
 		const int16_t *endloop;    // pointer to end data to be copied to beginning
-
-		const int _mtunebin = this->mtunebin;  // Update LO tune is possible during run
+		uint64_t seq;              // sequence number of this input buffer
 
 		{
+			// reserve next input buffer and its place in the output buffer,
+			//   while other threads might still process the previous ones
+			std::unique_lock<std::mutex> rk(mutexR2iqReserve);
 			std::unique_lock<std::mutex> lk(mutexR2iqControl);
-			dataADC = inputbuffer->getReadPtr();
+			seqWindowCV.wait(lk, [this] {
+				return !r2iqOn || seqReserved - seqDone < N_R2IQ_WINDOW;
+			});
+			if (!r2iqOn)
+				return 0;
+
+			// overflow_drop_oldest: skip the stale input, once none is in use
+			if (inputbuffer->DiscardPending())
+			{
+				seqWindowCV.wait(lk, [this] { return !r2iqOn || seqDone == seqReserved; });
+				if (!r2iqOn)
+					return 0;
+				inputbuffer->Discard();
+			}
+
+			seq = seqReserved;
+
+			// wait for the blocks without the control lock: the other threads
+			//   complete theirs meanwhile, but hold back the input's ReadDone()
+			//   until here, so the input offset stays. the output offsets only
+			//   get too large, waiting a little longer if at all
+			const int inWait = int(seq - seqDone);
+			int outWait[NDDCCHANNELS];
+			for (int c = 0; c < nchs; c++)
+				outWait[c] = int((seq >> chs[c].decimate) - (seqDone >> chs[c].decimate));
+			seqWaiting = true;
+			lk.unlock();
 
+			inputbuffer->getReadPtr(inWait);
+			for (int c = 0; c < nchs && r2iqOn; c++)
+				chs[c].outputbuffer->getWritePtr(outWait[c]);
+
+			lk.lock();
+			seqWaiting = false;
 			if (!r2iqOn)
 				return 0;
+			for (; seqReadPending > 0; seqReadPending--)
+				inputbuffer->ReadDone();
 
-			this->bufIdx = (this->bufIdx + 1) % QUEUE_SIZE;
+			const int inOffset = int(seq - seqDone);
+			dataADC = inputbuffer->peekReadPtr(inOffset);
+			endloop = inputbuffer->peekReadPtr(inOffset - 1) + transferSamples - halfFft;
 
-			endloop = inputbuffer->peekReadPtr(-1) + transferSamples - halfFft;
-		}
+			for (int c = 0; c < nchs; c++)
+			{
+				auto& ch = chs[c];
+				const int outOffset = int((seq >> ch.decimate) - (seqDone >> ch.decimate));
+				ch.pout = (fftwf_complex*)ch.outputbuffer->peekWritePtr(outOffset);
+				ch.pout += (seq & ch.decimate_mask) * ch.outPerBuf;
+			}
+			seqReserved++;
+			const uint64_t sequence = inputbuffer->getReadSequence(inOffset);
+			lk.unlock();
 
-		auto inloop = th->ADCinTime;
+			// the input tap, e.g. the recorder's copy: in order, as the reservations
+			//   are, but without holding up the other threads' completion
+			std::lock_guard<std::mutex> tk(mutexInputTap);
+			if (inputTap)
+				inputTap(inputTapContext, dataADC, transferSamples, sequence);
+		}
+		const uint64_t started = ringbufferbase::Now();
 
-		// @todo: move the following int16_t conversion to (32-bit) float
-		// directly inside the following loop (for "k < fftPerBuf")
-		//   just before the forward fft "fftwf_execute_dft_r2c" is called
-		// idea: this should improve cache/memory locality
 #if PRINT_INPUT_RANGE
 		std::pair<int16_t, int16_t> blockMinMax = std::make_pair<int16_t, int16_t>(0, 0);
-#endif
-		if (!this->getRand())        // plain samples no ADC rand set
 		{
-			convert_float<false>(endloop, inloop, halfFft);
-#if PRINT_INPUT_RANGE
 			auto minmax = std::minmax_element(dataADC, dataADC + transferSamples);
 			blockMinMax.first = *minmax.first;
 			blockMinMax.second = *minmax.second;
-#endif
-			convert_float<false>(dataADC, inloop + halfFft, transferSamples);
 		}
-		else
-		{
-			convert_float<true>(endloop, inloop, halfFft);
-			convert_float<true>(dataADC, inloop + halfFft, transferSamples);
-		}
-
-#if PRINT_INPUT_RANGE
 		th->MinValue = std::min(blockMinMax.first, th->MinValue);
 		th->MaxValue = std::max(blockMinMax.second, th->MaxValue);
 		++th->MinMaxBlockCount;
@@ -69,101 +140,130 @@
 			th->MinMaxBlockCount = 0;
 		}
 #endif
-		dataADC = nullptr;
-		inputbuffer->ReadDone();
 		// decimate in frequency plus tuning
+		for (int c = 0; c < nchs; c++)
+		{
+			auto& ch = chs[c];
+			ch.tunebin = ch.channel->tunebin;  // Update LO tune is possible during run
 
-		if (decimate_count == 0)
-			pout = (fftwf_complex*)outputbuffer->getWritePtr();
+			// the first half: count bins from tunebin on,
+			//   the second half: from tunebin - mfft / 2 on, but not below bin 0
+			ch.count = std::min(ch.mfft / 2, halfFft - ch.tunebin);
+			ch.start = std::max(0, ch.mfft / 2 - ch.tunebin);
 
-		decimate_count = (decimate_count + 1) & ((1 << decimate) - 1);
+			// fine tuning: the rest below half a bin, sign changes with the sideband
+			ch.fc = (lsb ? -ch.channel->finetune : ch.channel->finetune) * mratio[ch.decimate];
+			if (ch.fc != ch.fineStateFc)
+			{
+				ch.fineState = shift_limited_unroll_C_sse_init(ch.fc, 0.0F);
+				ch.fineStateFc = ch.fc;
+			}
+		}
 
-		// Calculate the parameters for the first half
-		const auto count = std::min(mfft/2, halfFft - _mtunebin);
-		const auto source = &th->ADCinFreq[_mtunebin];
+		// this input buffer's ffts for the spectrum: the first frames of an interval
+		int spectrumFfts = 0;
+		if (spectrumCallback)
+		{
+			const int64_t pos = (int64_t)(seq % spectrumInterval) * fftPerBuf;
+			spectrumFfts = (int)std::min<int64_t>(std::max<int64_t>(spectrumAverage - pos, 0), fftPerBuf);
+		}
 
-		// Calculate the parameters for the second half
-		const auto start = std::max(0, mfft / 2 - _mtunebin);
-		const auto source2 = &th->ADCinFreq[_mtunebin - mfft / 2];
-		const auto dest = &th->inFreqTmp[mfft / 2];
+		void (* const convert)(const int16_t*, float*, int) = this->getRand() ? convert_float<true> : convert_float<false>;
 		for (int k = 0; k < fftPerBuf; k++)
 		{
+			tracescope fftScope("fft", seq);
+
 			// core of fast convolution including filter and decimation
 			//   main part is 'overlap-scrap' (IMHO better name for 'overlap-save'), see
 			//   https://en.wikipedia.org/wiki/Overlap%E2%80%93save_method
+
+			// int16_t conversion to (32-bit) float of just this fft's window,
+			//   so it is still in the cache, when the fft reads it:
+			//   the input is endloop[0 .. halfFft) followed by dataADC[]
+			if (k == 0)
+			{
+				convert(endloop, th->ADCinTime, halfFft);
+				convert(dataADC, th->ADCinTime + halfFft, halfFft);
+			}
+			else
 			{
-				// FFT first stage: time to frequency, real to complex
-				// 'full' transformation size: 2 * halfFft
-				fftwf_execute_dft_r2c(plan_t2f_r2c, th->ADCinTime + (3 * halfFft / 2) * k, th->ADCinFreq);
-				// result now in th->ADCinFreq[]
+				convert(dataADC + (3 * halfFft / 2) * k - halfFft, th->ADCinTime, 2 * halfFft);
+			}
+
+			// FFT first stage: time to frequency, real to complex
+			// 'full' transformation size: 2 * halfFft
+			fftwf_execute_dft_r2c(plan_t2f_r2c, th->ADCinTime, th->ADCinFreq);
+			// result now in th->ADCinFreq[], the same for all channels
+
+			if (k == 0 && spectrumFfts > 0)
+				accumulate_power<false>((const float*)th->ADCinFreq, th->power, halfFft);
+			else if (k < spectrumFfts)
+				accumulate_power<true>((const float*)th->ADCinFreq, th->power, halfFft);
+
+			for (int c = 0; c < nchs; c++)
+			{
+				auto& ch = chs[c];
+				const int mfft = ch.mfft;
+
+				// this sub-block's part of the output
+				fftwf_complex* out = (k == 0) ? ch.pout : ch.pout + mfft / 2 + (3 * mfft / 4) * (k - 1);
+				const int outCount = (k == 0) ? mfft / 2 : 3 * mfft / 4;
 
 				// circular shift (mixing in full bins) and low/bandpass filtering (complex multiplication)
-				{
-					// circular shift tune fs/2 first half array into th->inFreqTmp[]
-					shift_freq(th->inFreqTmp, source, filter, 0, count);
-					if (mfft / 2 != count)
-						memset(th->inFreqTmp[count], 0, sizeof(float) * 2 * (mfft / 2 - count));
-
-					// circular shift tune fs/2 second half array
-					shift_freq(dest, source2, filter2, start, mfft/2);
-					if (start != 0)
-						memset(th->inFreqTmp[mfft / 2], 0, sizeof(float) * 2 * start);
-				}
+				//   lower sideband: mirror the spectrum already here, instead of
+				//   negating the imaginary Q of complex I/Q after the inverse fft
+				//   (plus the phase correction for bins, that are not a multiple of 4)
+				const auto source = &th->ADCinFreq[ch.tunebin];
+				const auto source2 = &th->ADCinFreq[ch.tunebin - mfft / 2];
+				const float* rot = binPhase(ch.tunebin, k, seq, transferSamples, halfFft);
+				if (lsb)
+					shift_bins<true>(th->inFreqTmp, mfft, source, ch.filter, ch.count, source2, ch.filter2, ch.start, rot);
+				else
+					shift_bins<false>(th->inFreqTmp, mfft, source, ch.filter, ch.count, source2, ch.filter2, ch.start, rot);
 				// result now in th->inFreqTmp[]
 
 				// 'shorter' inverse FFT transform (decimation); frequency (back) to COMPLEX time domain
-				// transform size: mfft = mfftdim[k] = halfFft / 2^k with k = mdecimation
-				fftwf_execute_dft(*plan_f2t_c2c, th->inFreqTmp, th->inFreqTmp);     //  c2c decimation
-				// result now in th->inFreqTmp[]
-			}
-
-			// postprocessing
-			// @todo: is it possible to ..
-			//  1)
-			//    let inverse FFT produce/save it's result directly
-			//    in "this->obuffers[modx] + offset" (pout)
-			//    ( obuffers[] would need to have additional space ..;
-			//      need to move 'scrap' of 'ovelap-scrap'? )
-			//    at least FFTW would allow so,
-			//      see http://www.fftw.org/fftw3_doc/New_002darray-Execute-Functions.html
-			//    attention: multithreading!
-			//  2)
-			//    could mirroring (lower sideband) get calculated together
-			//    with fine mixer - modifying the mixer frequency? (fs - fc)/fs
-			//    (this would reduce one memory pass)
-			if (lsb) // lower sideband
-			{
-				// mirror just by negating the imaginary Q of complex I/Q
-				if (k == 0)
+				// transform size: mfft = mfftdim[k] = halfFft / 2^k with k = decimate
+				//   the inner sub-blocks are written directly into their place in the
+				//   output buffer: the mfft/4 samples to scrap at their end get
+				//   overwritten by the following sub-block.
+				//   the first sub-block (scrap at both ends) and the last one (would
+				//   scrap into the next input buffer's output, maybe processed by
+				//   another thread) take the way through th->outTmp[]
+				if (k > 0 && k < fftPerBuf - 1 && fftwf_alignment_of((float*)out) == alignment)
 				{
-					copy<true>(pout, &th->inFreqTmp[mfft / 4], mfft/2);
+					fftwf_execute_dft(ch.plan_f2t_c2c, th->inFreqTmp, out);     //  c2c decimation
 				}
 				else
 				{
-					copy<true>(pout + mfft / 2 + (3 * mfft / 4) * (k - 1), &th->inFreqTmp[0], (3 * mfft / 4));
-				}
-			}
-			else // upper sideband
-			{
-				if (k == 0)
-				{
-					copy<false>(pout, &th->inFreqTmp[mfft / 4], mfft/2);
+					fftwf_execute_dft(ch.plan_f2t_c2c, th->inFreqTmp, th->outTmp);     //  c2c decimation
+					copy_iq<false>(out, &th->outTmp[k == 0 ? mfft / 4 : 0], outCount);
 				}
-				else
+
+				// fine tuning below half a bin, while the samples are still in the cache
+				if (ch.fc != 0.0f)
 				{
-					copy<false>(pout + mfft / 2 + (3 * mfft / 4) * (k - 1), &th->inFreqTmp[0], (3 * mfft / 4));
+					tracescope fineScope("fine tune", seq);
+					fine_tune(out, outCount, ch.fc, &ch.fineState, seq * ch.outPerBuf + (out - ch.pout));
 				}
+				// result now in the channel's output buffer
 			}
-			// result now in this->obuffers[]
 		}
+		dataADC = nullptr;
+
+		if (spectrumFfts > 0)
+			addSpectrum(th, seq, spectrumFfts);
+		const uint64_t finished = ringbufferbase::Now();
+		blockTime.Add(finished - started);
+		if (tracer::IsEnabled())
+			tracer::Record("r2iq block", started, finished, seq);
 
-		if (decimate_count == 0) {
-			outputbuffer->WriteDone();
-			pout = nullptr;
-		}
-		else
 		{
-			pout += mfft / 2 + (3 * mfft / 4) * (fftPerBuf - 1);
+			std::unique_lock<std::mutex> lk(mutexR2iqControl);
+			if (!r2iqOn)
+				return 0;
+
+			completeSeq(seq);
 		}
 	} // while(run)
 //    DbgPrintf((char *) "r2iqThreadf idx %d pthread_exit %u\n",(int)th->t, pthread_self());
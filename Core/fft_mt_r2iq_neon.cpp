@@ -7,3 +7,11 @@ void * fft_mt_r2iq::r2iqThreadf_neon(r2iqThreadArg *th)
 {
     #include "fft_mt_r2iq_impl.hpp"
 }
+
+void fft_mt_r2iq::convert_float_neon(const int16_t *input, float* output, int size, bool rand)
+{
+    if (rand)
+        convert_float<true>(input, output, size);
+    else
+        convert_float<false>(input, output, size);
+}
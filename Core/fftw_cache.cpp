@@ -0,0 +1,219 @@
+#include "fftw_cache.h"
+#include "config.h"
+#include "fftw3.h"
+
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <intrin.h>
+#include <process.h>
+#define getpid _getpid
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <unistd.h>
+#else
+#include <sys/auxv.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// new format or new kind of plans: a new file, the old one just stays unused
+static const int wisdomVersion = 1;
+
+static std::string loaded;      // the wisdom as imported (or last saved)
+static bool loadDone = false;
+
+std::mutex& FftwPlannerLock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+// plans are measured for this cpu: its brand string, or the hardware caps
+static std::string cpu_name()
+{
+	char brand[49] = { 0 };
+#if defined(_WIN32)
+	int info[4];
+	__cpuid(info, 0x80000000);
+	if ((unsigned)info[0] >= 0x80000004)
+	{
+		for (int i = 0; i < 3; i++)
+			__cpuid((int*)(brand + 16 * i), 0x80000002 + i);
+	}
+#elif defined(__x86_64__) || defined(__i386__)
+	unsigned int info[4];
+	if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004)
+	{
+		for (unsigned i = 0; i < 3; i++)
+		{
+			__get_cpuid(0x80000002 + i, &info[0], &info[1], &info[2], &info[3]);
+			memcpy(brand + 16 * i, info, sizeof(info));
+		}
+	}
+#else
+	snprintf(brand, sizeof(brand), "hwcap %lx", getauxval(AT_HWCAP));
+#endif
+	return brand;
+}
+
+static std::string cache_dir()
+{
+	const char* dir = getenv("SDDC_CACHE_DIR");
+	if (dir && *dir)
+		return dir;
+#ifdef _WIN32
+	dir = getenv("LOCALAPPDATA");
+	if (dir && *dir)
+		return std::string(dir) + "\\sddc";
+#else
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir && *dir)
+		return std::string(dir) + "/sddc";
+	dir = getenv("HOME");
+	if (dir && *dir)
+		return std::string(dir) + "/.cache/sddc";
+#endif
+	return std::string();
+}
+
+const std::string& CacheDirectory()
+{
+	static const std::string dir = cache_dir();
+	return dir;
+}
+
+// readers see either the old or the new file, never a partial one
+static std::string temp_name(const std::string& path)
+{
+	return path + "." + std::to_string(getpid()) + ".tmp";
+}
+
+static bool replace(const std::string& tmp, const std::string& path)
+{
+	std::error_code ec;
+	fs::rename(tmp, path, ec);
+	if (ec)
+	{
+		DbgPrintf("cache: can't replace %s\n", path.c_str());
+		fs::remove(tmp, ec);
+		return false;
+	}
+	return true;
+}
+
+bool CacheRead(const std::string& name, void* data, size_t size)
+{
+	if (CacheDirectory().empty())
+		return false;
+
+	const std::string path = (fs::path(CacheDirectory()) / name).string();
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (fp == nullptr)
+		return false;
+	bool ok = fread(data, 1, size, fp) == size && fgetc(fp) == EOF;
+	fclose(fp);
+	return ok;
+}
+
+bool CacheWrite(const std::string& name, const void* data, size_t size)
+{
+	if (CacheDirectory().empty())
+		return false;
+
+	std::error_code ec;
+	fs::create_directories(CacheDirectory(), ec);
+
+	const std::string path = (fs::path(CacheDirectory()) / name).string();
+	const std::string tmp = temp_name(path);
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if (fp == nullptr)
+	{
+		DbgPrintf("cache: can't write %s\n", tmp.c_str());
+		return false;
+	}
+	bool ok = fwrite(data, 1, size, fp) == size;
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok)
+	{
+		fs::remove(tmp, ec);
+		return false;
+	}
+	return replace(tmp, path);
+}
+
+const std::string& WisdomPath()
+{
+	static const std::string path = []() {
+		const std::string& dir = CacheDirectory();
+		if (dir.empty())
+			return std::string();
+
+		// FNV-1a of all the wisdom depends on
+		const std::string key = std::string(fftwf_version) + "|" + cpu_name();
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (unsigned char c : key)
+			hash = (hash ^ c) * 0x100000001b3ull;
+
+		char name[64];
+		snprintf(name, sizeof(name), "fftwf-wisdom-v%d-%016llx", wisdomVersion, (unsigned long long)hash);
+		return (fs::path(dir) / name).string();
+	}();
+	return path;
+}
+
+static std::string export_wisdom()
+{
+	char* wisdom = fftwf_export_wisdom_to_string();
+	if (wisdom == nullptr)
+		return std::string();
+	std::string result(wisdom);
+	free(wisdom);
+	return result;
+}
+
+bool WisdomLoad()
+{
+	if (loadDone)
+		return true;
+	loadDone = true;
+
+	const std::string& path = WisdomPath();
+	if (path.empty() || !fftwf_import_wisdom_from_filename(path.c_str()))
+	{
+		DbgPrintf("fftw wisdom: nothing cached in %s\n", path.c_str());
+		return false;
+	}
+	loaded = export_wisdom();
+	DbgPrintf("fftw wisdom: loaded %s\n", path.c_str());
+	return true;
+}
+
+bool WisdomSave()
+{
+	const std::string& path = WisdomPath();
+	if (path.empty() || export_wisdom() == loaded)
+		return false;
+
+	// what other processes found meanwhile
+	fftwf_import_wisdom_from_filename(path.c_str());
+
+	std::error_code ec;
+	fs::create_directories(CacheDirectory(), ec);
+
+	const std::string tmp = temp_name(path);
+	if (!fftwf_export_wisdom_to_filename(tmp.c_str()))
+	{
+		DbgPrintf("fftw wisdom: can't write %s\n", tmp.c_str());
+		return false;
+	}
+	if (!replace(tmp, path))
+		return false;
+	loaded = export_wisdom();
+	DbgPrintf("fftw wisdom: saved %s\n", path.c_str());
+	return true;
+}
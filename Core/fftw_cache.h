@@ -0,0 +1,32 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+
+// fftw's wisdom, cached per user instead of a "wisdom" file in the working directory:
+//   %LOCALAPPDATA%\sddc on windows, $XDG_CACHE_HOME/sddc or ~/.cache/sddc elsewhere
+//   ($SDDC_CACHE_DIR overrides both). the file name carries a format version and a key
+//   of fftw's version and the cpu, so wisdom measured elsewhere never gets used
+
+// the cache directory; empty, if there is none
+const std::string& CacheDirectory();
+
+// read a file of the cache, if it has exactly size bytes
+bool CacheRead(const std::string& name, void* data, size_t size);
+
+// (re)write a file of the cache: into a temporary file, renamed over the old one
+bool CacheWrite(const std::string& name, const void* data, size_t size);
+
+// fftw's planner is not thread safe: plan and destroy plans only with this locked
+std::mutex& FftwPlannerLock();
+
+// the cache file; empty, if there is no cache directory
+const std::string& WisdomPath();
+
+// import the cached wisdom, once per process. with the planner locked
+bool WisdomLoad();
+
+// export the wisdom, if there is new one since loading: merged with what other
+//   processes saved meanwhile, into a temporary file renamed over the cache file.
+//   with the planner locked
+bool WisdomSave();
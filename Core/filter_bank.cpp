@@ -0,0 +1,131 @@
+#include "filter_bank.h"
+#include "config.h"
+#include "fftw_cache.h"
+#include "fir.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <tuple>
+
+// a new design: a new version, the old files just stay unused
+static const int filterVersion = 2;
+
+static const float Astop = 120.0f;
+static const float relPass = 0.85f;  // 85% of Nyquist should be usable
+static const float relStop = 1.1f;   // 'some' alias back into transition band is OK
+
+typedef std::tuple<float, int, int> filterKey;     // gain, halfFft, decimate
+
+static std::mutex bankLock;
+static std::map<filterKey, std::weak_ptr<const FilterSpectrum>> bank;
+
+FilterSpectrum::FilterSpectrum(int size) :
+	size(size),
+	Hw((fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * size))
+{
+}
+
+FilterSpectrum::~FilterSpectrum()
+{
+	fftwf_free(Hw);
+}
+
+int DecimationFilterTaps(int decimate)
+{
+	float Bw = 64.0f / (1 << decimate);
+	return KaiserWindow(0, Astop, relPass * Bw / 128.0f, relStop * Bw / 128.0f, nullptr);
+}
+
+// the overlap-save scraps a quarter of each inverse fft: what fits there
+static int filter_taps(int halfFft, int decimate)
+{
+	return std::min(DecimationFilterTaps(decimate), halfFft / 4 + 1);
+}
+
+// the file of a filter: named by a hash of everything its design depends on
+static std::string cache_name(float gain, int halfFft, int decimate)
+{
+	struct {
+		float gain;
+		int32_t halfFft, decimate, taps;
+		float Astop, relPass, relStop;
+	} key = { gain, halfFft, decimate, filter_taps(halfFft, decimate), Astop, relPass, relStop };
+
+	uint8_t bytes[sizeof(key)];
+	memcpy(bytes, &key, sizeof(key));
+	uint64_t hash = 0xcbf29ce484222325ull;    // FNV-1a
+	for (uint8_t c : bytes)
+		hash = (hash ^ c) * 0x100000001b3ull;
+
+	char name[64];
+	snprintf(name, sizeof(name), "r2iq-filter-v%d-%016llx", filterVersion, (unsigned long long)hash);
+	return name;
+}
+
+static void design(float gain, int halfFft, int decimate, fftwf_complex* Hw)
+{
+	fftwf_complex *pfilterht = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * halfFft);    // time filter ht
+	fftwf_plan filterplan_t2f_c2c;     // time to frequency fft
+	{
+		// executed once only: measuring would take longer than that
+		std::lock_guard<std::mutex> lk(FftwPlannerLock());
+		filterplan_t2f_c2c = fftwf_plan_dft_1d(halfFft, pfilterht, Hw, FFTW_FORWARD, FFTW_ESTIMATE);
+	}
+
+	const int taps = filter_taps(halfFft, decimate);
+	if (taps < DecimationFilterTaps(decimate))
+		DbgPrintf("filter bank: decimation %d needs %d taps, fft size %d has room for %d\n",
+			decimate, DecimationFilterTaps(decimate), 2 * halfFft, taps);
+	float *pht = new float[taps];
+	float Bw = 64.0f / (1 << decimate);
+	KaiserWindow(taps, Astop, relPass * Bw / 128.0f, relStop * Bw / 128.0f, pht);
+
+	float gainadj = gain * 2048.0f / (float)(2 * halfFft); // reference is fft size 2048
+
+	for (int t = 0; t < halfFft; t++)
+	{
+		pfilterht[t][0] = pfilterht[t][1] = 0.0F;
+	}
+	for (int t = 0; t < taps; t++)
+	{
+		pfilterht[halfFft - 1 - t][0] = gainadj * pht[t];
+	}
+
+	fftwf_execute_dft(filterplan_t2f_c2c, pfilterht, Hw);
+	delete[] pht;
+	{
+		std::lock_guard<std::mutex> lk(FftwPlannerLock());
+		fftwf_destroy_plan(filterplan_t2f_c2c);
+	}
+	fftwf_free(pfilterht);
+}
+
+std::shared_ptr<const FilterSpectrum> GetDecimationFilter(float gain, int halfFft, int decimate)
+{
+	std::lock_guard<std::mutex> lk(bankLock);
+
+	const filterKey key(gain, halfFft, decimate);
+	auto filter = bank[key].lock();
+	if (filter)
+		return filter;
+
+	auto spectrum = std::make_shared<FilterSpectrum>(halfFft);
+	const std::string name = cache_name(gain, halfFft, decimate);
+	const size_t size = sizeof(fftwf_complex) * halfFft;
+	if (CacheRead(name, spectrum->Hw, size))
+	{
+		DbgPrintf("filter bank: %s cached\n", name.c_str());
+	}
+	else
+	{
+		design(gain, halfFft, decimate, spectrum->Hw);
+		CacheWrite(name, spectrum->Hw, size);
+		DbgPrintf("filter bank: %s designed\n", name.c_str());
+	}
+
+	bank[key] = spectrum;
+	return spectrum;
+}
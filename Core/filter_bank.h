@@ -0,0 +1,26 @@
+#pragma once
+
+#include "fftw3.h"
+#include <memory>
+
+// the lowpass filters of r2iq's overlap-save: their spectrum depends on the gain,
+//   the fft size and the decimation only. each one is designed on its first use -
+//   or read from the user cache (see fftw_cache.h) - and shared by all fft_mt_r2iq
+//   instances of the process as long as one of them holds it
+struct FilterSpectrum {
+    explicit FilterSpectrum(int size);
+    ~FilterSpectrum();
+    FilterSpectrum(const FilterSpectrum&) = delete;
+    FilterSpectrum& operator=(const FilterSpectrum&) = delete;
+
+    int size;           // halfFft bins
+    fftwf_complex* Hw;
+};
+
+// taps the filter of decimation 2^decimate needs for the design's 120 dB stopband
+int DecimationFilterTaps(int decimate);
+
+// the filter of decimation 2^decimate for an fft of 2 * halfFft real samples: with the
+//   taps it needs, but no more than the overlap of halfFft / 4 + 1 - a shorter one has
+//   a wider transition band. takes the fftw planner lock, so not with it locked
+std::shared_ptr<const FilterSpectrum> GetDecimationFilter(float gain, int halfFft, int decimate);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// histogram of durations on the stream's hot path (r2iq's blocks, the callbacks),
+//   in log2 buckets of microseconds. Add() takes a few relaxed atomics only, the
+//   readers get a snapshot with Get(), which may be torn by a block or two
+class timehistogram
+{
+public:
+    static const int buckets = 20;  // [0]: below 1 us, [b]: 2^(b-1) up to 2^b us, the last one: longer
+
+    struct values {
+        uint64_t count;
+        uint64_t total;             // ns
+        uint64_t max;               // ns
+        uint64_t counts[buckets];
+    };
+
+    timehistogram() { Reset(); }
+
+    void Add(uint64_t ns)
+    {
+        int b = 0;
+        for (uint64_t us = ns / 1000; us > 0 && b < buckets - 1; us >>= 1)
+            b++;
+        counts[b].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(ns, std::memory_order_relaxed);
+
+        uint64_t m = max.load(std::memory_order_relaxed);
+        while (ns > m && !max.compare_exchange_weak(m, ns, std::memory_order_relaxed))
+            ;
+    }
+
+    values Get() const
+    {
+        values v;
+        v.count = count.load(std::memory_order_relaxed);
+        v.total = total.load(std::memory_order_relaxed);
+        v.max = max.load(std::memory_order_relaxed);
+        for (int b = 0; b < buckets; b++)
+            v.counts[b] = counts[b].load(std::memory_order_relaxed);
+        return v;
+    }
+
+    // the upper edge of the bucket, below which fraction of them are, in ns
+    static uint64_t Percentile(const values& v, double fraction)
+    {
+        uint64_t sum = 0;
+        for (int b = 0; b < buckets - 1; b++)
+        {
+            sum += v.counts[b];
+            if (sum >= fraction * v.count)
+                return 1000ull << b;
+        }
+        return v.max;
+    }
+
+    void Reset()
+    {
+        for (int b = 0; b < buckets; b++)
+            counts[b].store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> counts[buckets];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> max;
+};
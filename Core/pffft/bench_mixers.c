@@ -111,8 +111,7 @@ void save(complexf * d, int B, int N, const char * fn)
             return;
         fn = "bench.bin";
     }
-    FILE* f;
-    fopen_s(&f, fn, "wb");
+    FILE* f = fopen(fn, "wb");
     if (!f) {
         fprintf(stderr, "error writing result to %s\n", fn);
         return;
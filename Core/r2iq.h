@@ -3,6 +3,7 @@
 #include "license.txt" 
 
 #define NDECIDX 7  //number of srate
+#define NDDCCHANNELS 8  // ddc channels from one adc stream, including the main output
 
 #include <thread>
 #include <mutex>
@@ -10,9 +11,17 @@
 #include <atomic>
 
 #include "dsp/ringbuffer.h"
+#include "metrics.h"
 
 struct r2iqThreadArg;
 
+// a power spectrum of bins, from 0 to half the ADC rate (see fft_mt_r2iq::setSpectrum())
+typedef void (*r2iqSpectrumCb)(void* context, const float* power, int bins);
+
+// an input buffer of samples, in order, as a thread takes it up (see setInputTap()).
+//   sequence: the block's in the inputbuffer, gaps where blocks were lost
+typedef void (*r2iqInputTap)(void* context, const int16_t* block, uint32_t samples, uint64_t sequence);
+
 class r2iqControlClass {
 public:
     r2iqControlClass();
@@ -35,12 +44,35 @@ public:
     virtual void DataReady(void) {}
     virtual float setFreqOffset(float offset) { return 0; };
 
+    // additional ddc channels (1 .. NDDCCHANNELS - 1) besides the main output (0),
+    //   each with its own output buffers, decimation and tuning.
+    //   add and remove only while turned off; AddChannel returns -1, if not possible
+    virtual int AddChannel(ringbuffer<float>* obuffers, int dec) { return -1; }
+    virtual void RemoveChannel(int channel) {}
+    virtual float setChannelFreqOffset(int channel, float offset) { return 0; }
+
+    // size of the first (real) fft, only while turned off; false if not supported.
+    //   0: chosen for the decimations in use
+    virtual bool setFftSize(int size) { return false; }
+    virtual int getFftSize() const { return 0; }
+
+    // power spectrum of the input, only while turned off; false if not supported
+    virtual bool setSpectrum(int bins, int frames, int interval, r2iqSpectrumCb callback, void* context) { return false; }
+
+    // every input buffer processed, e.g. for a recorder; also while turned on.
+    //   nullptr removes it: after the return, it is not called anymore. false if not supported
+    virtual bool setInputTap(r2iqInputTap callback, void* context) { return false; }
+
+    // time to process an input buffer, in the threads; empty if not measured
+    const timehistogram& getBlockTime() const { return blockTime; }
+
 protected:
     int mdecimation ;   // selected decimation ratio
       // 64 Msps:               0 => 32Msps, 1=> 16Msps, 2 = 8Msps, 3 = 4Msps, 4 = 2Msps
       // 128 Msps: 0 => 64Msps, 1 => 32Msps, 2=> 16Msps, 3 = 8Msps, 4 = 4Msps, 5 = 2Msps
     bool r2iqOn;        // r2iq on flag
     int mratio [NDECIDX];  // ratio
+    timehistogram blockTime;
 
 private:
     bool randADC;       // randomized ADC output
@@ -0,0 +1,90 @@
+#include "resampler.h"
+#include "fir.h"
+#include <math.h>
+#include <string.h>
+
+resampler::resampler(double ratio) :
+    ratio(ratio),
+    step((uint64_t)(4294967296.0 / ratio + 0.5)),
+    pos(0)
+{
+    const float Astop = 90.0f;
+    // passband as r2iq's filters: 85% of the output's Nyquist; the stopband starts,
+    //   where the aliases would fold back into this passband
+    const float fpass = 0.85f * 0.5f * (float)ratio;
+    const float fstop = 1.15f * 0.5f * (float)ratio;
+
+    taps = KaiserWindow(0, Astop, fpass, fstop, nullptr);
+    taps = (taps + 1) & ~1;
+    if (taps < 8)
+        taps = 8;
+
+    // prototype at phases times the input rate
+    std::vector<float> proto(taps * phases + 1);
+    KaiserWindow(taps * phases + 1, Astop, fpass / phases, fstop / phases, proto.data());
+
+    // branch p, reversed: coefs[p * taps + taps - 1 - t] = proto[t * phases + p]
+    coefs.resize((phases + 1) * taps);
+    for (int p = 0; p <= phases; p++)
+    {
+        for (int t = 0; t < taps; t++)
+        {
+            coefs[p * taps + taps - 1 - t] = phases * proto[t * phases + p];
+        }
+    }
+
+    Reset();
+}
+
+void resampler::Reset()
+{
+    pos = 0;
+    history.assign(2 * (taps - 1), 0.0f);
+}
+
+uint32_t resampler::Process(const float* input, uint32_t count)
+{
+    const int keep = taps - 1;
+    history.resize(2 * (keep + count));
+    memcpy(&history[2 * keep], input, sizeof(float) * 2 * count);
+
+    output.resize(2 * ((size_t)(count * ratio) + 2));
+
+    uint32_t n = 0;
+    const uint64_t end = (uint64_t)count << 32;
+    while (pos < end)
+    {
+        // integer sample, polyphase branch and the fraction between two branches
+        const int i = (int)(pos >> 32);
+        const uint32_t frac = (uint32_t)pos;
+        const int p = frac >> (32 - phaseBits);
+        const float a = (float)(frac & ((1u << (32 - phaseBits)) - 1)) * (1.0f / (1u << (32 - phaseBits)));
+
+        // input samples i - (taps - 1) .. i
+        const float* x = &history[2 * i];
+        const float* c0 = &coefs[p * taps];
+        const float* c1 = c0 + taps;
+        float re = 0.0f;
+        float im = 0.0f;
+        for (int j = 0; j < taps; j++)
+        {
+            const float c = c0[j] + a * (c1[j] - c0[j]);
+            re += x[2 * j] * c;
+            im += x[2 * j + 1] * c;
+        }
+
+        if (2 * n + 2 > output.size())
+            output.resize(output.size() + 2);
+        output[2 * n] = re;
+        output[2 * n + 1] = im;
+        n++;
+
+        pos += step;
+    }
+    pos -= end;
+
+    memmove(&history[0], &history[2 * count], sizeof(float) * 2 * keep);
+    history.resize(2 * keep);
+
+    return n;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// polyphase resampler for complex (interleaved I/Q) float streams
+//   to an arbitrary rate below the input rate: ratio = output rate / input rate in (0, 1].
+//   the fractional phase is interpolated linearly between the prototype's
+//   polyphase branches, so any ratio works - not only rational ones with a small denominator.
+//   the lowpass keeps 85% of the output's Nyquist, like r2iq's filters do
+class resampler
+{
+public:
+    resampler(double ratio);
+
+    // resample count complex input samples, the result is in getOutput();
+    //   returns the number of complex output samples
+    uint32_t Process(const float* input, uint32_t count);
+
+    const float* getOutput() const { return output.data(); }
+
+    double getRatio() const { return ratio; }
+
+    void Reset();
+
+private:
+    static const int phaseBits = 7;
+    static const int phases = 1 << phaseBits;
+
+    // positions in input samples, fixed point 32.32: exact, independent of the block sizes
+    double ratio;
+    uint64_t step;      // input samples per output sample
+    uint64_t pos;       // position of the next output sample, relative to the next input block
+    int taps;           // taps per polyphase branch
+
+    std::vector<float> coefs;     // (phases + 1) branches of taps each, the last one continues the first
+    std::vector<float> history;   // the last taps - 1 input samples, followed by the current block
+    std::vector<float> output;
+};
@@ -0,0 +1,160 @@
+#include "tracer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> tracer::enabled(false);
+
+namespace {
+	struct event {
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+		uint64_t arg;
+	};
+
+	// the events of a thread, a ring of the latest ones. only the thread writes,
+	//   Dump() reads. a thread, which ended, leaves its buffer to the next one
+	//   of its name
+	struct threadbuffer {
+		event events[tracer::events];
+		std::atomic<uint64_t> count;    // recorded, the last ones are in events[count % events]
+		std::atomic<uint64_t> cleared;  // the ones before are forgotten
+		std::atomic<bool> owned;        // by a running thread
+		char name[32];                  // of the track; under the registry lock
+	};
+
+	std::mutex registry;
+	std::vector<threadbuffer*> buffers;     // never freed, reused
+
+	thread_local char threadName[32];
+
+	struct owner {
+		threadbuffer* buffer = nullptr;
+		~owner()
+		{
+			if (buffer)
+				buffer->owned.store(false, std::memory_order_release);
+		}
+	};
+	thread_local owner current;
+
+	threadbuffer* ThisThread()
+	{
+		if (current.buffer)
+			return current.buffer;
+
+		std::lock_guard<std::mutex> lk(registry);
+		threadbuffer* buffer = nullptr;
+		for (auto b : buffers)
+		{
+			// the track of an ended thread of the same name, e.g. r2iq's after a restart
+			if (!b->owned.load(std::memory_order_acquire) && strcmp(b->name, threadName) == 0)
+			{
+				buffer = b;
+				break;
+			}
+		}
+		if (buffer == nullptr)
+		{
+			buffer = new threadbuffer();
+			buffers.push_back(buffer);
+		}
+		buffer->owned.store(true, std::memory_order_relaxed);
+		memcpy(buffer->name, threadName, sizeof(buffer->name));
+		current.buffer = buffer;
+		return buffer;
+	}
+}
+
+void tracer::Record(const char* name, uint64_t start, uint64_t end, uint64_t arg)
+{
+	threadbuffer* buffer = ThisThread();
+	const uint64_t n = buffer->count.load(std::memory_order_relaxed);
+	event& e = buffer->events[n % events];
+	e.name = name;
+	e.start = start;
+	e.end = end;
+	e.arg = arg;
+	buffer->count.store(n + 1, std::memory_order_release);
+}
+
+void tracer::SetThreadName(const char* name)
+{
+	snprintf(threadName, sizeof(threadName), "%s", name);
+	// a quote or backslash would need escaping in the json
+	for (char* c = threadName; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			*c = '_';
+	}
+
+	if (current.buffer)
+	{
+		std::lock_guard<std::mutex> lk(registry);
+		memcpy(current.buffer->name, threadName, sizeof(threadName));
+	}
+}
+
+void tracer::Clear()
+{
+	std::lock_guard<std::mutex> lk(registry);
+	for (auto b : buffers)
+		b->cleared.store(b->count.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+bool tracer::Dump(const char* path)
+{
+	FILE* fp = fopen(path, "w");
+	if (fp == nullptr)
+		return false;
+
+	std::lock_guard<std::mutex> lk(registry);
+
+	// copy first: the threads go on recording meanwhile
+	std::vector<std::vector<event>> copies(buffers.size());
+	uint64_t base = UINT64_MAX;
+	for (size_t t = 0; t < buffers.size(); t++)
+	{
+		threadbuffer* b = buffers[t];
+		const uint64_t n = b->count.load(std::memory_order_acquire);
+		uint64_t from = std::max(b->cleared.load(std::memory_order_relaxed), n > events ? n - events : 0);
+		std::vector<event>& copy = copies[t];
+		for (uint64_t i = from; i < n; i++)
+			copy.push_back(b->events[i % events]);
+
+		// without the ones overwritten while copying
+		const uint64_t after = b->count.load(std::memory_order_acquire);
+		if (after > events && after - events > from)
+			copy.erase(copy.begin(), copy.begin() + (size_t)std::min<uint64_t>(after - events - from, copy.size()));
+		for (auto& e : copy)
+			base = std::min(base, e.start);
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	const char* separator = "";
+	for (size_t t = 0; t < buffers.size(); t++)
+	{
+		const int tid = (int)t + 1;
+		if (buffers[t]->name[0])
+			fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+				separator, tid, buffers[t]->name);
+		else
+			fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+				separator, tid, tid);
+		separator = ",\n";
+
+		// complete events, in us since the first one
+		for (auto& e : copies[t])
+		{
+			fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"arg\": %llu}}",
+				e.name, tid, (e.start - base) / 1000.0, (e.end - e.start) / 1000.0, (unsigned long long)e.arg);
+		}
+	}
+	fprintf(fp, "\n]}\n");
+
+	return fclose(fp) == 0;
+}
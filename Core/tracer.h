@@ -0,0 +1,59 @@
+#pragma once
+
+#include "dsp/ringbuffer.h"
+
+#include <stdint.h>
+#include <atomic>
+
+// timeline of the stream's stages (USB, r2iq's ffts, the callbacks), for the
+//   Chrome trace viewer or Perfetto. off by default: a scope costs one relaxed
+//   load then. on, each thread records into its own buffer of the latest events,
+//   without locks; Dump() writes what the buffers hold as Chrome trace JSON
+class tracer
+{
+public:
+    static const int events = 65536;    // kept per thread, the older ones get overwritten
+
+    static void Enable(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // an event of this thread: name must stay valid (a literal), times in
+    //   ringbufferbase::Now()'s ns, arg e.g. the block's sequence number
+    static void Record(const char* name, uint64_t start, uint64_t end, uint64_t arg = 0);
+
+    // the name of this thread's track, e.g. "r2iq"; copied
+    static void SetThreadName(const char* name);
+
+    // the events of all threads so far, also while they record; false if the
+    //   file can't be written
+    static bool Dump(const char* path);
+
+    // forget the events recorded so far
+    static void Clear();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// traces the enclosing block as an event, if the tracer is on at its start
+class tracescope
+{
+public:
+    tracescope(const char* name, uint64_t arg = 0) :
+        name(tracer::IsEnabled() ? name : nullptr),
+        arg(arg),
+        start(this->name ? ringbufferbase::Now() : 0)
+    {
+    }
+
+    ~tracescope()
+    {
+        if (name)
+            tracer::Record(name, start, ringbufferbase::Now(), arg);
+    }
+
+private:
+    const char* name;
+    uint64_t arg;
+    uint64_t start;
+};
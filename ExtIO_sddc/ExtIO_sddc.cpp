@@ -54,6 +54,7 @@ const char RegKeyName[] = "SOFTWARE\\SDDC";
 
 
 RadioHandlerClass RadioHandler;
+unsigned long Failures = 0;
 
 // Dialog callback
 
@@ -240,6 +241,7 @@ bool __declspec(dllexport) __stdcall InitHW(char *name, char *model, int& type)
 		idx = selected;
 		Fx3->Enumerate(idx, devicelist.dev[idx], res_data, res_size);
 
+		RadioHandler.UpdateSampleRate(adcnominalfreq);
 		gbInitHW = Fx3->Open(res_data, res_size) &&
 				RadioHandler.Init(Fx3, Callback); // Check if it there hardware
 	
@@ -397,7 +397,7 @@ BOOL CALLBACK DlgMainFn(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 			switch (HIWORD(wParam))
 			{
 			case BN_CLICKED:
-				saveADCsamplesflag = true;
+				RadioHandler.SaveADCSamples();
 				break;
 			}
 			break;
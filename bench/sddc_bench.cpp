@@ -0,0 +1,399 @@
+/*
+ * sddc_bench - throughput of the r2iq DSP chain (fft_mt_r2iq)
+ *
+ * runs the engine on synthetic or recorded raw ADC input (int16) for each
+ * fft size, decimation, instruction set, sideband and thread count and reports
+ * ns/sample, Msps and the headroom versus real time at 64 and 128 Msps.
+ * setup is the time to design the filters and plan the ffts for a run: the
+ * startup cost, which the cached fftw wisdom (see fftw_cache.h) cuts down.
+ * the int16 to float conversion is timed on its own as well: the reference
+ * loop versus the kernel r2iq picks on this cpu (text and json only).
+ *
+ * usage: sddc_bench [options]
+ *   -i <file>     raw ADC capture (int16) instead of synthetic input
+ *   -F <list>     fft sizes, e.g. 2048,32768; 0: by decimation (default: 0)
+ *   -d <list>     decimations, e.g. 0,2,4            (default: all)
+ *   -s <list>     def,avx,avx2,avx512,neon          (default: all supported)
+ *   -t <list>     thread counts, e.g. 1,2,4          (default: 1 .. max)
+ *   -b <list>     usb,lsb                            (default: both)
+ *   -n <blocks>   input blocks per measurement      (default: 256)
+ *   -f <format>   text, csv or json                 (default: text)
+ *   -o <file>     write the report there            (default: stdout)
+ */
+
+#include "fft_mt_r2iq.h"
+#include "config.h"
+#include "git_version.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std::chrono;
+
+struct result {
+    const char* isa;
+    int fftSize;
+    int decimate;
+    bool lsb;
+    unsigned threads;
+    int blocks;
+    double nsPerSample;
+    double msps;
+    float setupMs;
+};
+
+struct convert_result {
+    double ref;         // ns/sample
+    double simd;
+    double refRand;     // with de-randomization
+    double simdRand;
+};
+
+static std::vector<std::string> split(const char* list)
+{
+    std::vector<std::string> items;
+    std::string item;
+    for (const char* p = list; ; p++)
+    {
+        if (*p == ',' || *p == 0)
+        {
+            if (!item.empty())
+                items.push_back(item);
+            item.clear();
+            if (*p == 0)
+                break;
+        }
+        else
+            item += *p;
+    }
+    return items;
+}
+
+// the first (blocks) input blocks: noise plus a few carriers, or the file
+static bool fill_input(ringbuffer<int16_t>& input, const char* filename)
+{
+    FILE* fp = nullptr;
+    if (filename)
+    {
+        fp = fopen(filename, "rb");
+        if (fp == nullptr)
+        {
+            fprintf(stderr, "ERROR - can't open %s\n", filename);
+            return false;
+        }
+    }
+
+    uint32_t seed = 1;
+    for (int i = 0; i < input.getCount(); i++)
+    {
+        auto ptr = input.peekWritePtr(i);
+        if (fp)
+        {
+            size_t n = fread(ptr, sizeof(int16_t), transferSamples, fp);
+            if (n < transferSamples)
+            {
+                // short file: start over
+                rewind(fp);
+                n += fread(ptr + n, sizeof(int16_t), transferSamples - n, fp);
+                if (n < transferSamples)
+                    memset(ptr + n, 0, (transferSamples - n) * sizeof(int16_t));
+            }
+            continue;
+        }
+        for (uint32_t k = 0; k < transferSamples; k++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            uint32_t n = i * transferSamples + k;
+            ptr[k] = (int16_t)((int16_t)(seed >> 16) >> 6) + ((n * 7) & 0x3ff) - ((n * 13) & 0x7ff);
+        }
+    }
+
+    if (fp)
+        fclose(fp);
+    return true;
+}
+
+// input samples per second through r2iq; the first output block is the
+//   warm up (thread start, first plans executed) and doesn't count
+static double measure(fft_mt_r2iq* r2iq, ringbuffer<int16_t>& input, ringbuffer<float>& output,
+    int decimate, int blocks, float& setupMs, int& fftSize)
+{
+    input.Reset();
+    output.Reset();
+    r2iq->setDecimate(decimate);
+    r2iq->TurnOn();
+    setupMs = r2iq->getSetupTime();
+    fftSize = r2iq->getFftSize();
+
+    auto producer = std::thread([&input, blocks]() {
+        for (int i = 0; i < blocks; i++)
+        {
+            input.getWritePtr();
+            input.WriteDone();
+        }
+    });
+
+    const int outblocks = blocks >> decimate;
+    steady_clock::time_point start;
+    for (int i = 0; i < outblocks; i++)
+    {
+        output.getReadPtr();
+        output.ReadDone();
+        if (i == 0)
+            start = steady_clock::now();
+    }
+    duration<double> elapsed = steady_clock::now() - start;
+
+    r2iq->TurnOff();
+    producer.join();
+
+    return (double)(outblocks - 1) * (1 << decimate) * transferSamples / elapsed.count();
+}
+
+// func(r) has to touch its input every round and return some of its output,
+//   otherwise the compiler may hoist the (unchanged) conversion out of the
+//   loop or drop it altogether
+template<typename F> static double measure_ns_per_sample(F func, int size, int rounds)
+{
+    volatile float sink;
+    auto start = steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        sink = func(r);
+    (void)sink;
+    duration<double, std::nano> elapsed = steady_clock::now() - start;
+    return elapsed.count() / ((double)size * rounds);
+}
+
+// one transfer at a time, as r2iq converts it
+static convert_result measure_convert()
+{
+    const int size = transferSamples;
+    const int rounds = 1000;
+    std::vector<int16_t> input(size);
+    std::vector<float> output(size);
+    for (int i = 0; i < size; i++)
+        input[i] = (int16_t)(i * 2654435761u >> 16);
+    auto convert = fft_mt_r2iq::getConvertFloat();
+
+    convert_result r;
+    r.ref = measure_ns_per_sample([&](int n) { input[n] ^= 1; convert_float_ref<false>(input.data(), output.data(), size); return output[n]; }, size, rounds);
+    r.simd = measure_ns_per_sample([&](int n) { input[n] ^= 1; convert(input.data(), output.data(), size, false); return output[n]; }, size, rounds);
+    r.refRand = measure_ns_per_sample([&](int n) { input[n] ^= 1; convert_float_ref<true>(input.data(), output.data(), size); return output[n]; }, size, rounds);
+    r.simdRand = measure_ns_per_sample([&](int n) { input[n] ^= 1; convert(input.data(), output.data(), size, true); return output[n]; }, size, rounds);
+    return r;
+}
+
+static void report(FILE* out, const char* format, float initMs, const convert_result& conv, const std::vector<result>& results)
+{
+    if (!strcmp(format, "csv"))
+    {
+        fprintf(out, "isa,fft_size,decimate,sideband,threads,blocks,ns_per_sample,msps,realtime_64msps,realtime_128msps,setup_ms\n");
+        for (auto& r : results)
+            fprintf(out, "%s,%d,%d,%s,%u,%d,%.4f,%.2f,%.3f,%.3f,%.2f\n", r.isa, r.fftSize, r.decimate, r.lsb ? "lsb" : "usb",
+                r.threads, r.blocks, r.nsPerSample, r.msps, r.msps / 64.0, r.msps / 128.0, r.setupMs);
+    }
+    else if (!strcmp(format, "json"))
+    {
+        fprintf(out, "{\n  \"version\": \"%s\",\n  \"transfer_samples\": %u,\n  \"init_ms\": %.2f,\n", kGitHash, (unsigned)transferSamples, initMs);
+        fprintf(out, "  \"convert\": { \"ref_ns_per_sample\": %.4f, \"ns_per_sample\": %.4f, \"rand_ref_ns_per_sample\": %.4f, \"rand_ns_per_sample\": %.4f },\n",
+            conv.ref, conv.simd, conv.refRand, conv.simdRand);
+        fprintf(out, "  \"results\": [\n");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            auto& r = results[i];
+            fprintf(out, "    { \"isa\": \"%s\", \"fft_size\": %d, \"decimate\": %d, \"sideband\": \"%s\", \"threads\": %u, \"blocks\": %d, "
+                "\"ns_per_sample\": %.4f, \"msps\": %.2f, \"realtime_64msps\": %.3f, \"realtime_128msps\": %.3f, \"setup_ms\": %.2f }%s\n",
+                r.isa, r.fftSize, r.decimate, r.lsb ? "lsb" : "usb", r.threads, r.blocks, r.nsPerSample, r.msps,
+                r.msps / 64.0, r.msps / 128.0, r.setupMs, i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+    else
+    {
+        fprintf(out, "sddc_bench %s, init %.1f ms\n", kGitHash, initMs);
+        fprintf(out, "convert_float:        reference %.3f ns/sample, r2iq's %.3f ns/sample (x%.1f)\n", conv.ref, conv.simd, conv.ref / conv.simd);
+        fprintf(out, "convert_float (rand): reference %.3f ns/sample, r2iq's %.3f ns/sample (x%.1f)\n", conv.refRand, conv.simdRand, conv.refRand / conv.simdRand);
+        fprintf(out, "%-7s %6s %3s %4s %7s %10s %9s %8s %8s %9s\n", "isa", "fft", "dec", "sb", "threads", "ns/sample", "Msps", "x64Msps", "x128Msps", "setup ms");
+        for (auto& r : results)
+            fprintf(out, "%-7s %6d %3d %4s %7u %10.3f %9.1f %8.2f %8.2f %9.1f\n", r.isa, r.fftSize, r.decimate, r.lsb ? "lsb" : "usb",
+                r.threads, r.nsPerSample, r.msps, r.msps / 64.0, r.msps / 128.0, r.setupMs);
+    }
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-i <raw int16 file>] [-F <fft sizes>] [-d <decimations>] [-s <def,avx,avx2,avx512,neon>]\n"
+        "          [-t <thread counts>] [-b <usb,lsb>] [-n <blocks>] [-f <text|csv|json>] [-o <file>]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const char* filename = nullptr;
+    const char* outname = nullptr;
+    const char* format = "text";
+    int blocks = 256;
+    std::vector<int> fftSizes;
+    std::vector<int> decimations;
+    std::vector<fft_mt_r2iq::SimdLevel> isas;
+    std::vector<unsigned> threads;
+    std::vector<bool> sidebands;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (arg[0] != '-' || arg[1] == 0 || arg[2] != 0 || i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return -1;
+        }
+        const char* value = argv[++i];
+        switch (arg[1])
+        {
+        case 'i':
+            filename = value;
+            break;
+        case 'o':
+            outname = value;
+            break;
+        case 'f':
+            format = value;
+            break;
+        case 'n':
+            blocks = atoi(value);
+            break;
+        case 'F':
+            for (auto& f : split(value))
+                fftSizes.push_back(atoi(f.c_str()));
+            break;
+        case 'd':
+            for (auto& d : split(value))
+                decimations.push_back(atoi(d.c_str()));
+            break;
+        case 't':
+            for (auto& t : split(value))
+                threads.push_back((unsigned)atoi(t.c_str()));
+            break;
+        case 'b':
+            for (auto& b : split(value))
+                sidebands.push_back(b == "lsb");
+            break;
+        case 's':
+            for (auto& s : split(value))
+            {
+                int level = fft_mt_r2iq::SIMD_DEF;
+                while (level <= fft_mt_r2iq::SIMD_NEON && s != fft_mt_r2iq::getSimdName((fft_mt_r2iq::SimdLevel)level))
+                    level++;
+                if (level > fft_mt_r2iq::SIMD_NEON)
+                {
+                    fprintf(stderr, "ERROR - unknown instruction set '%s'\n", s.c_str());
+                    return -1;
+                }
+                isas.push_back((fft_mt_r2iq::SimdLevel)level);
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (strcmp(format, "text") && strcmp(format, "csv") && strcmp(format, "json"))
+    {
+        usage(argv[0]);
+        return -1;
+    }
+    // whole output blocks for all decimations
+    if (blocks < (2 << (NDECIDX - 1)))
+        blocks = 2 << (NDECIDX - 1);
+
+    if (fftSizes.empty())
+        fftSizes.push_back(0);
+    if (decimations.empty())
+        for (int d = 0; d < NDECIDX; d++)
+            decimations.push_back(d);
+    if (isas.empty())
+        for (int level = fft_mt_r2iq::SIMD_DEF; level <= fft_mt_r2iq::SIMD_NEON; level++)
+            if (fft_mt_r2iq::isSimdSupported((fft_mt_r2iq::SimdLevel)level))
+                isas.push_back((fft_mt_r2iq::SimdLevel)level);
+    if (threads.empty())
+        for (unsigned t = 1; t <= N_MAX_R2IQ_THREADS; t++)
+            threads.push_back(t);
+    if (sidebands.empty())
+    {
+        sidebands.push_back(false);
+        sidebands.push_back(true);
+    }
+
+    ringbuffer<int16_t> input;
+    ringbuffer<float> output;
+    input.setBlockSize(transferSamples);
+    output.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+    if (!fill_input(input, filename))
+        return -1;
+
+    const convert_result conv = measure_convert();
+
+    auto r2iq = new fft_mt_r2iq();
+    r2iq->Init(1.0f, &input, &output);
+    const float initMs = r2iq->getSetupTime();
+    r2iq->setFreqOffset(0.3f);   // somewhere inside, not a multiple of 4 bins
+
+    std::vector<result> results;
+    for (int fftSize : fftSizes)
+    {
+        if (!r2iq->setFftSize(fftSize))
+        {
+            fprintf(stderr, "WARNING - fft size %d not supported, skipped\n", fftSize);
+            continue;
+        }
+        for (auto isa : isas)
+        {
+            if (!r2iq->setSimd(isa))
+            {
+                fprintf(stderr, "WARNING - %s not supported here, skipped\n", fft_mt_r2iq::getSimdName(isa));
+                continue;
+            }
+            for (auto t : threads)
+            {
+                r2iq->setThreads(t);
+                for (bool lsb : sidebands)
+                {
+                    r2iq->setSideband(lsb);
+                    for (int d : decimations)
+                    {
+                        if (d < 0 || d >= NDECIDX)
+                            continue;
+                        float setupMs;
+                        int size;
+                        double sps = measure(r2iq, input, output, d, blocks, setupMs, size);
+                        results.push_back({ fft_mt_r2iq::getSimdName(isa), size, d, lsb, r2iq->getThreads(), blocks,
+                            1e9 / sps, sps / 1e6, setupMs });
+                    }
+                }
+            }
+        }
+    }
+
+    delete r2iq;
+
+    FILE* out = stdout;
+    if (outname)
+    {
+        out = fopen(outname, "w");
+        if (out == nullptr)
+        {
+            fprintf(stderr, "ERROR - can't write %s\n", outname);
+            return -1;
+        }
+    }
+    report(out, format, initMs, conv, results);
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
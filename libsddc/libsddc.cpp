@@ -2,75 +2,203 @@
 #include "config.h"
 #include "r2iq.h"
 #include "RadioHandler.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
 
 struct sddc
 {
     SDDCStatus status;
     RadioHandlerClass* handler;
+    fx3class* fx3;
     uint8_t led;
     int samplerateidx;
+    double sample_rate;
     double freq;
 
+    enum SDDCStreamFormat format;
     sddc_read_async_cb_t callback;
     void *callback_context;
+    uint32_t frame_size;    // 0: the stream's blocks
+    uint32_t num_frames;    // 0: default queue
+
+    // the callback's frames, where they don't line up with the stream's blocks
+    std::vector<uint8_t> frame;
+    uint32_t frame_fill;
+    blockstamp frame_stamp; // of its first sample
+
+    // sddc_get_timestamp(): of the data given out last
+    blockstamp stamp;
+
+    sddc_spectrum_cb_t spectrum_callback;
+    void *spectrum_context;
+
+    // sddc_read_sync(): the block acquired, what of it is not yet read
+    const uint8_t *sync_block;
+    uint32_t sync_size;
+    uint32_t sync_offset;
+    blockstamp sync_stamp;
 };
 
-sddc_t *current_running;
+// RadioHandlerClass::Start() decimates by srate_idx_decimation(t, 0) - srate_idx
+static int srate_idx_decimation(sddc_t *t, int srate_idx)
+{
+    return ((t->handler->getSampleRate() > N2_BANDSWITCH) ? 5 : 4) - srate_idx;
+}
 
-static void Callback(void* context, const float* data, uint32_t len)
+static double decimation_rate(sddc_t *t, int decimate)
 {
+    return t->handler->getSampleRate() / 2.0 / (1 << decimate);
 }
 
-class rawdata : public r2iqControlClass {
-    void Init(float gain, ringbuffer<int16_t>* buffers, ringbuffer<float>* obuffers) override
-    {
-        idx = 0;
-    }
+// the highest decimation, whose rate is still at least sample_rate; -1 if none
+static int sample_rate_decimation(sddc_t *t, double sample_rate)
+{
+    if (sample_rate <= 0 || sample_rate > decimation_rate(t, 0))
+        return -1;
+
+    int decimate = 0;
+    while (decimate + 1 < NDECIDX && decimation_rate(t, decimate + 1) >= sample_rate)
+        decimate++;
+    return decimate;
+}
+
+struct sddc_channel
+{
+    sddc_t *sddc;
+    int channel;
+    double sample_rate;
+    double freq;
+
+    sddc_channel_cb_t callback;
+    void *callback_context;
+    blockstamp stamp;       // of the block given to the callback
+};
+
+// bytes per sample and per block of the stream
+static uint32_t sample_bytes(enum SDDCStreamFormat format)
+{
+    return format == SDDC_FORMAT_RAW_INT16 ? sizeof(int16_t) : 2 * sizeof(float);
+}
+
+static uint32_t block_bytes(enum SDDCStreamFormat format)
+{
+    return format == SDDC_FORMAT_RAW_INT16 ? transferSize : EXT_BLOCKLEN * 2 * sizeof(float);
+}
 
-    void TurnOn() override
+// the stream's blocks into frames of frame_size: slices of the block in place,
+// where they line up, or else gathered in the frame buffer
+static void Deliver(sddc_t *t, const uint8_t *data, uint32_t size)
+{
+    const uint32_t frame_size = (uint32_t)t->frame.size();
+    const uint32_t bytes = sample_bytes(t->format);
+    const blockstamp block = t->handler->GetStamp();
+    blockstamp at = block;
+    for (uint32_t offset = 0; size > 0; at.sample = block.sample + offset / bytes)
     {
-        this->r2iqOn = true;
-        idx = 0;
+        if (t->frame_fill == 0 && size >= frame_size)
+        {
+            t->stamp = at;
+            t->callback(frame_size, (uint8_t *)data, t->callback_context);
+            data += frame_size;
+            size -= frame_size;
+            offset += frame_size;
+            continue;
+        }
+
+        if (t->frame_fill == 0)
+            t->frame_stamp = at;
+        const uint32_t n = std::min(frame_size - t->frame_fill, size);
+        memcpy(t->frame.data() + t->frame_fill, data, n);
+        t->frame_fill += n;
+        data += n;
+        size -= n;
+        offset += n;
+        if (t->frame_fill == frame_size)
+        {
+            t->stamp = t->frame_stamp;
+            t->callback(frame_size, t->frame.data(), t->callback_context);
+            t->frame_fill = 0;
+        }
     }
+}
 
-private:
-    int idx;
-};
+static void Callback(void* context, const float* data, uint32_t len)
+{
+    Deliver((sddc_t*)context, (const uint8_t*)data, len * 2 * sizeof(float));
+}
+
+static void RawCallback(void* context, const int16_t* data, uint32_t len)
+{
+    Deliver((sddc_t*)context, (const uint8_t*)data, len * sizeof(int16_t));
+}
+
+static void ChannelCallback(void* context, const float* data, uint32_t len)
+{
+    auto c = (sddc_channel_t*)context;
+    c->stamp = c->sddc->handler->GetStamp(c->channel);
+    c->callback(len, data, c->callback_context);
+}
+
+static void SpectrumCallback(void* context, const float* power, int bins)
+{
+    auto t = (sddc_t*)context;
+    t->spectrum_callback((uint32_t)bins, power, t->spectrum_context);
+}
 
 int sddc_get_device_count()
 {
-    return 1;
+    return (int)ListUsbDevices().size();
 }
 
 int sddc_get_device_info(struct sddc_device_info **sddc_device_infos)
 {
-    auto ret = new sddc_device_info();
-    const char *todo = "TODO";
-    ret->manufacturer = todo;
-    ret->product = todo;
-    ret->serial_number = todo;
+    auto devices = ListUsbDevices();
+
+    // ends with an entry of null pointers, as libusb's list
+    auto ret = new sddc_device_info[devices.size() + 1]();
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        ret[i].manufacturer = strdup(devices[i].manufacturer.c_str());
+        ret[i].product = strdup(devices[i].product.c_str());
+        ret[i].serial_number = strdup(devices[i].serialNumber.c_str());
+    }
 
     *sddc_device_infos = ret;
 
-    return 1;
+    return (int)devices.size();
 }
 
 int sddc_free_device_info(struct sddc_device_info *sddc_device_infos)
 {
-    delete sddc_device_infos;
+    for (auto info = sddc_device_infos; info->manufacturer || info->product || info->serial_number; info++)
+    {
+        free((void*)info->manufacturer);
+        free((void*)info->product);
+        free((void*)info->serial_number);
+    }
+    delete[] sddc_device_infos;
     return 0;
 }
 
-sddc_t *sddc_open(int index, const char* imagefile)
+static void init_handler(sddc_t *t, fx3class *fx3)
 {
-    auto ret_val = new sddc_t();
+    t->fx3 = fx3;
+    t->handler = new RadioHandlerClass();
 
-    fx3class *fx3 = CreateUsbHandler();
-    if (fx3 == nullptr)
+    // no callback: the main output is pulled with sddc_acquire_block()
+    if (t->handler->Init(fx3, nullptr))
     {
-        return nullptr;
+        t->status = SDDC_STATUS_READY;
+        t->samplerateidx = 0;
+        t->sample_rate = decimation_rate(t, srate_idx_decimation(t, 0));
     }
+}
 
+sddc_t *sddc_open(int index, const char* imagefile)
+{
     // open the firmware
     unsigned char* res_data;
     uint32_t res_size;
@@ -85,19 +213,45 @@ sddc_t *sddc_open(int index, const char* imagefile)
     res_size = ftell(fp);
     res_data = (unsigned char*)malloc(res_size);
     fseek(fp, 0, SEEK_SET);
-    if (fread(res_data, 1, res_size, fp) != res_size)
+    bool readOK = fread(res_data, 1, res_size, fp) == res_size;
+    fclose(fp);
+    if (!readOK)
+    {
+        free(res_data);
         return nullptr;
+    }
 
-    bool openOK = fx3->Open(res_data, res_size);
+    // each device has its own handler, USB context and threads
+    fx3class *fx3 = CreateUsbHandler(index);
+    bool openOK = fx3 != nullptr && fx3->Open(res_data, res_size);
+    free(res_data);
     if (!openOK)
+    {
+        delete fx3;
         return nullptr;
+    }
+
+    auto ret_val = new sddc_t();
+    init_handler(ret_val, fx3);
+
+    return ret_val;
+}
 
-    ret_val->handler = new RadioHandlerClass();
+sddc_t *sddc_open_file(const char *filename, double adc_rate, int flags)
+{
+    // pace at the given ADC rate, or the default one
+    const uint32_t rate = adc_rate > 0 ? (uint32_t)adc_rate : DEFAULT_ADC_FREQ;
+    fx3class *fx3 = CreateFileHandler(filename,
+        (flags & SDDC_FILE_PACED) ? rate : 0, (flags & SDDC_FILE_LOOP) != 0);
+    if (fx3 == nullptr)
+        return nullptr;
 
-    if (ret_val->handler->Init(fx3, Callback, new rawdata()))
+    auto ret_val = new sddc_t();
+    init_handler(ret_val, fx3);
+    if (adc_rate > 0)
     {
-        ret_val->status = SDDC_STATUS_READY;
-        ret_val->samplerateidx = 0;
+        ret_val->handler->UpdateSampleRate(rate);
+        ret_val->sample_rate = decimation_rate(ret_val, srate_idx_decimation(ret_val, 0));
     }
 
     return ret_val;
@@ -107,6 +261,7 @@ void sddc_close(sddc_t *that)
 {
     if (that->handler)
         delete that->handler;
+    delete that->fx3;
     delete that;
 }
 
@@ -235,6 +390,11 @@ int sddc_set_adc_dither(sddc_t *t, int dither)
     return 0;
 }
 
+double sddc_get_adc_rate(sddc_t *t)
+{
+    return t->handler->getSampleRate();
+}
+
 int sddc_get_adc_random(sddc_t *t)
 {
     return t->handler->GetRand();
@@ -328,31 +488,65 @@ int sddc_set_vhf_bias(sddc_t *t, int bias)
 
 double sddc_get_sample_rate(sddc_t *t)
 {
-    return 0;
+    return t->sample_rate;
 }
 
 int sddc_set_sample_rate(sddc_t *t, double sample_rate)
 {
-    switch((int64_t)sample_rate)
-    {
-        case 32000000:
-            t->samplerateidx = 0;
-            break;
-        case 16000000:
-            t->samplerateidx = 1;
-            break;
-        case 8000000:
-            t->samplerateidx = 2;
-            break;
-        case 4000000:
-            t->samplerateidx = 3;
-            break;
-        case 2000000:
-            t->samplerateidx = 4;
-            break;
-        default:
-            return -1;
-    }
+    const int decimate = sample_rate_decimation(t, sample_rate);
+    if (decimate < 0)
+        return -1;
+
+    // any other rate gets resampled from the decimation's one
+    const bool exact = decimation_rate(t, decimate) == sample_rate;
+    if (!t->handler->SetOutputRate(0, exact ? 0.0 : sample_rate))
+        return -1;
+
+    t->samplerateidx = srate_idx_decimation(t, 0) - decimate;
+    t->sample_rate = sample_rate;
+    return 0;
+}
+
+int sddc_get_fft_size(sddc_t *t)
+{
+    return t->handler->GetFftSize();
+}
+
+int sddc_set_fft_size(sddc_t *t, int fft_size)
+{
+    return t->handler->SetFftSize(fft_size) ? 0 : -1;
+}
+
+int sddc_set_spectrum(sddc_t *t, uint32_t bins, uint32_t frames, double fps,
+                      sddc_spectrum_cb_t callback, void *callback_context)
+{
+    if (!t->handler->SetSpectrum((int)bins, (int)frames, (float)fps,
+                                 callback ? SpectrumCallback : nullptr, t))
+        return -1;
+
+    t->spectrum_callback = callback;
+    t->spectrum_context = callback_context;
+    return 0;
+}
+
+int sddc_start_recording(sddc_t *t, const char *path, uint64_t max_bytes,
+                         double max_seconds)
+{
+    return t->handler->StartRecording(path, max_bytes, max_seconds) ? 0 : -1;
+}
+
+int sddc_stop_recording(sddc_t *t)
+{
+    return t->handler->StopRecording() ? 0 : -1;
+}
+
+int sddc_set_stream_format(sddc_t *t, enum SDDCStreamFormat format)
+{
+    if (t->status == SDDC_STATUS_STREAMING ||
+        (format != SDDC_FORMAT_IQ_FLOAT32 && format != SDDC_FORMAT_RAW_INT16))
+        return -1;
+
+    t->format = format;
     return 0;
 }
 
@@ -360,28 +554,135 @@ int sddc_set_async_params(sddc_t *t, uint32_t frame_size,
                           uint32_t num_frames, sddc_read_async_cb_t callback,
                           void *callback_context)
 {
-    // TODO: ignore frame_size, num_frames
+    if (t->status == SDDC_STATUS_STREAMING)
+        return -1;
+
     t->callback = callback;
     t->callback_context = callback_context;
+    t->frame_size = frame_size;
+    t->num_frames = num_frames;
     return 0;
 }
 
 int sddc_start_streaming(sddc_t *t)
 {
-    current_running = t;
+    // whole samples per frame; raw samples only to a callback
+    const bool raw = t->format == SDDC_FORMAT_RAW_INT16;
+    const uint32_t block = block_bytes(t->format);
+    const uint32_t frame = t->frame_size ? t->frame_size : block;
+    if (frame % sample_bytes(t->format) != 0 || (raw && t->callback == nullptr))
+        return -1;
+
+    // num_frames frames, in the stream's blocks
+    int depth = 0;
+    if (t->num_frames > 0)
+        depth = std::max(MIN_QUEUE_DEPTH, (int)(((uint64_t)t->num_frames * frame + block - 1) / block));
+
+    t->frame.resize(frame);
+    t->frame_fill = 0;
+    t->stamp = { 0, 0 };
+    if (!t->handler->SetQueueDepth(depth) ||
+        !t->handler->SetRawCallback(raw ? RawCallback : nullptr, t) ||
+        !t->handler->SetCallback(!raw && t->callback ? Callback : nullptr, t))
+        return -1;
+
+    t->sync_block = nullptr;
     t->handler->Start(t->samplerateidx);
+    t->status = SDDC_STATUS_STREAMING;
     return 0;
 }
 
-int sddc_handle_events(sddc_t *t)
+int sddc_set_overflow_policy(sddc_t *t, enum SDDCOverflowPolicy policy)
+{
+    switch (policy)
+    {
+    case SDDC_OVERFLOW_BLOCK:
+        return t->handler->SetOverflowPolicy(overflow_block) ? 0 : -1;
+    case SDDC_OVERFLOW_DROP_NEWEST:
+        return t->handler->SetOverflowPolicy(overflow_drop_newest) ? 0 : -1;
+    case SDDC_OVERFLOW_DROP_OLDEST:
+        return t->handler->SetOverflowPolicy(overflow_drop_oldest) ? 0 : -1;
+    default:
+        return -1;
+    }
+}
+
+uint64_t sddc_get_lost_samples(sddc_t *t)
+{
+    return t->handler->GetLostBlocks() * transferSamples;
+}
+
+int sddc_get_timestamp(sddc_t *t, uint64_t *sample, uint64_t *time_ns)
+{
+    *sample = t->stamp.sample;
+    *time_ns = t->stamp.time;
+    return 0;
+}
+
+static void copy_ring_metrics(struct sddc_ring_metrics *to, const ringmetrics &from)
+{
+    to->blocks = from.blocks;
+    to->filled = from.filled;
+    to->high_water = from.highWater;
+    to->full_waits = from.fullWaits;
+    to->empty_waits = from.emptyWaits;
+    to->lost_blocks = from.lost;
+}
+
+static void copy_time_histogram(struct sddc_time_histogram *to, const timehistogram::values &from)
+{
+    static_assert(SDDC_METRICS_BUCKETS == timehistogram::buckets, "histogram buckets");
+    to->count = from.count;
+    to->total_ns = from.total;
+    to->max_ns = from.max;
+    for (int b = 0; b < SDDC_METRICS_BUCKETS; b++)
+        to->buckets[b] = from.counts[b];
+}
+
+int sddc_get_metrics(sddc_t *t, struct sddc_metrics *metrics)
+{
+    const pipelinemetrics m = t->handler->GetMetrics();
+    metrics->usb_bytes = m.usbBytes;
+    metrics->usb_bytes_per_sec = m.usbBytesPerSec;
+    metrics->transfers_in_flight = m.transfersInFlight;
+    metrics->output_samples_per_sec = m.outputSamplesPerSec;
+    copy_ring_metrics(&metrics->input, m.input);
+    copy_ring_metrics(&metrics->output, m.output);
+    copy_time_histogram(&metrics->ddc_block, m.r2iqBlock);
+    copy_time_histogram(&metrics->callback, m.callback);
+    return 0;
+}
+
+int sddc_set_metrics_dump(sddc_t *t, double interval)
 {
+    if (interval < 0)
+        return -1;
+
+    t->handler->SetMetricsDump((float)interval);
+    return 0;
+}
+
+int sddc_trace_enable(int enable)
+{
+    tracer::Enable(enable != 0);
     return 0;
 }
 
+int sddc_trace_dump(const char *path)
+{
+    return tracer::Dump(path) ? 0 : -1;
+}
+
+int sddc_handle_events(sddc_t *t)
+{
+    return t->handler->BlocksReady();
+}
+
 int sddc_stop_streaming(sddc_t *t)
 {
     t->handler->Stop();
-    current_running = nullptr;
+    t->sync_block = nullptr;
+    t->status = SDDC_STATUS_READY;
     return 0;
 }
 
@@ -390,7 +691,126 @@ int sddc_reset_status(sddc_t *t)
     return 0;
 }
 
+int sddc_acquire_block(sddc_t *t, const float **data, uint32_t *samples,
+                       uint64_t *sequence)
+{
+    *data = t->handler->AcquireBlock(samples, sequence);
+    if (*data == nullptr)
+        return -1;
+
+    t->stamp = t->handler->GetStamp();
+    return 0;
+}
+
+int sddc_release_block(sddc_t *t)
+{
+    t->handler->ReleaseBlock();
+    return 0;
+}
+
 int sddc_read_sync(sddc_t *t, uint8_t *data, int length, int *transferred)
 {
+    int done = 0;
+    while (done < length)
+    {
+        if (t->sync_block == nullptr)
+        {
+            const float *block;
+            uint32_t samples;
+            uint64_t sequence;
+            if (sddc_acquire_block(t, &block, &samples, &sequence) < 0)
+                break;
+            t->sync_block = (const uint8_t *)block;
+            t->sync_size = samples * 2 * sizeof(float);
+            t->sync_offset = 0;
+            t->sync_stamp = t->stamp;
+        }
+        if (done == 0)
+        {
+            t->stamp.sample = t->sync_stamp.sample + t->sync_offset / (2 * sizeof(float));
+            t->stamp.time = t->sync_stamp.time;
+        }
+
+        // straight out of the ring, the rest of the block stays for the next call
+        const uint32_t n = std::min((uint32_t)(length - done), t->sync_size - t->sync_offset);
+        memcpy(data + done, t->sync_block + t->sync_offset, n);
+        done += n;
+        t->sync_offset += n;
+        if (t->sync_offset == t->sync_size)
+        {
+            t->sync_block = nullptr;
+            sddc_release_block(t);
+        }
+    }
+
+    if (transferred)
+        *transferred = done;
+    return done == length ? 0 : -1;
+}
+
+
+/* DDC channel functions */
+sddc_channel_t *sddc_channel_open(sddc_t *t, double sample_rate,
+                                  sddc_channel_cb_t callback,
+                                  void *callback_context)
+{
+    const int decimate = sample_rate_decimation(t, sample_rate);
+    if (decimate < 0 || callback == nullptr)
+        return nullptr;
+
+    auto ret_val = new sddc_channel_t();
+    ret_val->sddc = t;
+    ret_val->sample_rate = sample_rate;
+    ret_val->freq = t->freq;
+    ret_val->callback = callback;
+    ret_val->callback_context = callback_context;
+
+    ret_val->channel = t->handler->AddChannel(decimate, ChannelCallback, ret_val);
+    if (ret_val->channel < 0)
+    {
+        delete ret_val;
+        return nullptr;
+    }
+    t->handler->TuneChannel(ret_val->channel, (uint64_t)ret_val->freq);
+    // any other rate gets resampled from the decimation's one
+    if (decimation_rate(t, decimate) != sample_rate)
+        t->handler->SetOutputRate(ret_val->channel, sample_rate);
+
+    return ret_val;
+}
+
+int sddc_channel_close(sddc_channel_t *c)
+{
+    if (!c->sddc->handler->RemoveChannel(c->channel))
+        return -1;
+
+    delete c;
+    return 0;
+}
+
+int sddc_channel_get_timestamp(sddc_channel_t *c, uint64_t *sample,
+                               uint64_t *time_ns)
+{
+    *sample = c->stamp.sample;
+    *time_ns = c->stamp.time;
+    return 0;
+}
+
+double sddc_channel_get_sample_rate(sddc_channel_t *c)
+{
+    return c->sample_rate;
+}
+
+double sddc_channel_get_frequency(sddc_channel_t *c)
+{
+    return c->freq;
+}
+
+int sddc_channel_set_frequency(sddc_channel_t *c, double frequency)
+{
+    if (frequency < 0)
+        return -1;
+
+    c->freq = (double)c->sddc->handler->TuneChannel(c->channel, (uint64_t)frequency);
     return 0;
 }
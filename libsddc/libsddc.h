@@ -69,12 +69,25 @@ enum LEDColors {
 /* basic functions */
 int sddc_get_device_count();
 
+/* the attached devices in the order of sddc_open()'s index; the list ends
+ * with an entry of null pointers */
 int sddc_get_device_info(struct sddc_device_info **sddc_device_infos);
 
 int sddc_free_device_info(struct sddc_device_info *sddc_device_infos);
 
+/* every sddc_t has its own USB context, buffers and threads: several devices
+ * may be open and streaming at the same time */
 sddc_t *sddc_open(int index, const char* imagefile);
 
+/* replay a raw ADC capture (int16 samples) instead of a device, e.g. for
+ * offline processing or benchmarks; adc_rate 0 is the default ADC rate */
+enum SDDCFileFlags {
+  SDDC_FILE_PACED = 0x01,   /* at the ADC rate, not as fast as possible */
+  SDDC_FILE_LOOP  = 0x02    /* start over at the end of the file */
+};
+
+sddc_t *sddc_open_file(const char *filename, double adc_rate, int flags);
+
 void sddc_close(sddc_t *t);
 
 enum SDDCStatus sddc_get_status(sddc_t *t);
@@ -101,10 +114,15 @@ int sddc_led_toggle(sddc_t *t, uint8_t led_pattern);
 
 
 /* ADC functions */
+/* the ADC's sampling rate: the rate of the raw samples (SDDC_FORMAT_RAW_INT16) */
+double sddc_get_adc_rate(sddc_t *t);
+
 int sddc_get_adc_dither(sddc_t *t);
 
 int sddc_set_adc_dither(sddc_t *t, int dither);
 
+/* 1, if the ADC randomizes its output: the raw samples need de-randomizing
+ * (see SDDC_FORMAT_RAW_INT16), the I/Q stream has it done already */
 int sddc_get_adc_random(sddc_t *t);
 
 int sddc_set_adc_random(sddc_t *t, int random);
@@ -143,27 +161,183 @@ int sddc_set_vhf_bias(sddc_t *t, int bias);
 
 
 /* streaming functions */
+
+/* what the stream delivers: float I/Q out of the DDC (default), or the raw int16
+ * samples of the ADC, as they come from USB. only while not streaming.
+ * raw samples are not de-randomized: while sddc_get_adc_random() is 1, the ADC
+ * XORs bits 15..1 of each sample with its bit 0, so the caller has to undo
+ * that with (s & 1) ? s ^ 0xfffe : s. toggle it only while not streaming, or
+ * the stream changes encoding in the middle of a frame */
+enum SDDCStreamFormat {
+  SDDC_FORMAT_IQ_FLOAT32,
+  SDDC_FORMAT_RAW_INT16
+};
+
+int sddc_set_stream_format(sddc_t *t, enum SDDCStreamFormat format);
+
 typedef void (*sddc_read_async_cb_t)(uint32_t data_size, uint8_t *data,
                                       void *context);
 
 double sddc_get_sample_rate(sddc_t *t);
 
+/* any rate up to half the ADC rate: the ADC rate / 2^(k+1) directly, others
+ * are resampled from the next higher of these */
 int sddc_set_sample_rate(sddc_t *t, double sample_rate);
 
+/* size of the first FFT of the DDC: 2048, 8192, 32768 or 131072
+ * smaller ones cost less CPU, larger ones give sharper filters; only while not streaming.
+ * 0 (default): the smallest one with the full stopband for the decimations in use */
+int sddc_get_fft_size(sddc_t *t);
+
+int sddc_set_fft_size(sddc_t *t, int fft_size);
+
+/* power spectrum of the whole ADC band (0 to ADC rate / 2), e.g. for a panadapter,
+ * out of the DDC's FFTs at little extra cost: bins (a power of 2) bins, each the
+ * mean power of frames FFTs, normalized to the FFT size, about fps times a second.
+ * called from a DDC thread; callback NULL turns it off; only while not streaming */
+typedef void (*sddc_spectrum_cb_t)(uint32_t bins, const float *power,
+                                   void *context);
+
+int sddc_set_spectrum(sddc_t *t, uint32_t bins, uint32_t frames, double fps,
+                      sddc_spectrum_cb_t callback, void *callback_context);
+
+/* record the raw ADC samples into SigMF files: <path>-0000.sigmf-data (int16)
+ * and <path>-0000.sigmf-meta with rate, frequency and gains, continued in -0001, ..
+ * after max_bytes or max_seconds (0: no limit). before or while streaming; a
+ * recorder too slow for the stream loses blocks, rather than stalling it */
+int sddc_start_recording(sddc_t *t, const char *path, uint64_t max_bytes,
+                         double max_seconds);
+
+int sddc_stop_recording(sddc_t *t);
+
+/* the callback gets frames of frame_size bytes (0: the stream's blocks, 256 KiB of
+ * I/Q or 128 KiB of raw samples), from the stream's thread. frames, which divide the
+ * blocks, point into them (for raw samples: into the USB frame), others are gathered.
+ * num_frames: frames queued before the callback, rounded up to blocks (0: default).
+ * callback NULL: pull mode (see below), I/Q only. only while not streaming */
 int sddc_set_async_params(sddc_t *t, uint32_t frame_size, 
                           uint32_t num_frames, sddc_read_async_cb_t callback,
                           void *callback_context);
 
 int sddc_start_streaming(sddc_t *t);
 
+/* what happens, when the DDC falls behind the ADC: the USB transfers wait for
+ * room (default; the samples get lost in the device, on Linux counted in
+ * sddc_get_lost_samples() from the stall's length), or the newest block or all
+ * queued ones get dropped, keeping the latency short. where the transfers can't
+ * wait (Linux without zero-copy), the default drops the newest block. only while
+ * not streaming */
+enum SDDCOverflowPolicy {
+  SDDC_OVERFLOW_BLOCK,
+  SDDC_OVERFLOW_DROP_NEWEST,
+  SDDC_OVERFLOW_DROP_OLDEST
+};
+
+int sddc_set_overflow_policy(sddc_t *t, enum SDDCOverflowPolicy policy);
+
+/* ADC samples dropped since sddc_start_streaming */
+uint64_t sddc_get_lost_samples(sddc_t *t);
+
+/* where the data given out last starts: the frame given to the callback (valid
+ * within the callback), the block acquired or what sddc_read_sync read. sample
+ * counts the stream's samples since sddc_start_streaming, lost ones included, so a
+ * jump beyond the samples delivered is a gap. time_ns: the host's monotonic clock,
+ * when the ADC block of that sample came in over USB */
+int sddc_get_timestamp(sddc_t *t, uint64_t *sample, uint64_t *time_ns);
+
+/* the pipeline's counters: USB to the DDC (input), the DDC to the callback
+ * (output), and the time spent per block in the DDC and in the callbacks */
+#define SDDC_METRICS_BUCKETS 20
+
+struct sddc_ring_metrics {
+  int blocks;               /* size of the queue */
+  int filled;               /* blocks queued now */
+  int high_water;           /* most blocks queued since sddc_start_streaming */
+  int full_waits;           /* the producer waited for room, since sddc_open */
+  int empty_waits;          /* the consumer waited for a block, since sddc_open */
+  uint64_t lost_blocks;     /* dropped or skipped since sddc_start_streaming */
+};
+
+struct sddc_time_histogram {
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  /* [0]: below 1 us, [b]: 2^(b-1) up to 2^b us, the last one: longer */
+  uint64_t buckets[SDDC_METRICS_BUCKETS];
+};
+
+struct sddc_metrics {
+  uint64_t usb_bytes;           /* since sddc_start_streaming, lost ones included */
+  double usb_bytes_per_sec;     /* over the last second or so */
+  int transfers_in_flight;
+  double output_samples_per_sec;
+  struct sddc_ring_metrics input;
+  struct sddc_ring_metrics output;
+  struct sddc_time_histogram ddc_block;   /* per ADC block, in each DDC thread */
+  struct sddc_time_histogram callback;    /* the callbacks of all outputs */
+};
+
+int sddc_get_metrics(sddc_t *t, struct sddc_metrics *metrics);
+
+/* a summary of the metrics on stderr every interval seconds while streaming;
+ * 0 turns it off */
+int sddc_set_metrics_dump(sddc_t *t, double interval);
+
+/* a timeline of the stages (USB, the DDC's FFTs, fine tuning, resampling, the
+ * callbacks) of all streams: each thread keeps its latest events, with little
+ * overhead, and sddc_trace_dump writes them as Chrome trace JSON, e.g. for
+ * ui.perfetto.dev or chrome://tracing. off by default */
+int sddc_trace_enable(int enable);
+
+int sddc_trace_dump(const char *path);
+
+/* pull mode: output blocks ready to acquire without waiting, -1 if not streaming */
 int sddc_handle_events(sddc_t *t);
 
 int sddc_stop_streaming(sddc_t *t);
 
 int sddc_reset_status(sddc_t *t);
 
+/* pull mode: the output blocks (interleaved float I/Q) straight out of the DDC's
+ * ring, in order and one at a time. sddc_acquire_block waits for the next one;
+ * it stays valid until sddc_release_block. sequence counts the blocks since
+ * sddc_start_streaming. -1 if not streaming */
+int sddc_acquire_block(sddc_t *t, const float **data, uint32_t *samples,
+                       uint64_t *sequence);
+
+int sddc_release_block(sddc_t *t);
+
+/* length bytes of the output (interleaved float I/Q), copied out of the acquired
+ * blocks; a partly read block is continued by the next call. waits until all
+ * are there: -1, if streaming stopped before */
 int sddc_read_sync(sddc_t *t, uint8_t *data, int length, int *transferred);
 
+
+/* DDC channel functions - more narrowband outputs from the same ADC stream
+ * each channel has its own sample rate, frequency and callback; open and close channels only while not streaming
+ * and close them before sddc_close() */
+typedef struct sddc_channel sddc_channel_t;
+
+/* count complex samples, interleaved I/Q */
+typedef void (*sddc_channel_cb_t)(uint32_t count, const float *iq,
+                                  void *context);
+
+sddc_channel_t *sddc_channel_open(sddc_t *t, double sample_rate,
+                                  sddc_channel_cb_t callback,
+                                  void *callback_context);
+
+int sddc_channel_close(sddc_channel_t *c);
+
+/* of the samples given to the callback, within the callback; see sddc_get_timestamp */
+int sddc_channel_get_timestamp(sddc_channel_t *c, uint64_t *sample,
+                               uint64_t *time_ns);
+
+double sddc_channel_get_sample_rate(sddc_channel_t *c);
+
+double sddc_channel_get_frequency(sddc_channel_t *c);
+
+int sddc_channel_set_frequency(sddc_channel_t *c, double frequency);
+
 #ifdef __cplusplus
 }
 #endif
@@ -112,23 +112,16 @@ static double clk_diff() {
 
 int main(int argc, char **argv)
 {
-  if (argc < 3) {
-    fprintf(stderr, "usage: %s <image file> <sample rate> [<runtime_in_ms> [<output_filename>]\n", argv[0]);
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <image file> [<runtime_in_ms> [<output_filename>]\n", argv[0]);
     return -1;
   }
   char *imagefile = argv[1];
   const char *outfilename = 0;
-  double sample_rate = 0.0;
-  sscanf(argv[2], "%lf", &sample_rate);
+  if (2 < argc)
+    runtime = atoi(argv[2]);
   if (3 < argc)
-    runtime = atoi(argv[3]);
-  if (4 < argc)
-    outfilename = argv[4];
-
-  if (sample_rate <= 0) {
-    fprintf(stderr, "ERROR - given samplerate '%f' should be > 0\n", sample_rate);
-    return -1;
-  }
+    outfilename = argv[3];
 
   int ret_val = -1;
 
@@ -138,8 +131,10 @@ int main(int argc, char **argv)
     return -1;
   }
 
-  if (sddc_set_sample_rate(sddc, sample_rate) < 0) {
-    fprintf(stderr, "ERROR - sddc_set_sample_rate() failed\n");
+  /* the real 16-bit ADC samples, at the ADC's rate */
+  const double sample_rate = sddc_get_adc_rate(sddc);
+  if (sddc_set_stream_format(sddc, SDDC_FORMAT_RAW_INT16) < 0) {
+    fprintf(stderr, "ERROR - sddc_set_stream_format() failed\n");
     goto DONE;
   }
 
@@ -0,0 +1,61 @@
+#include "fft_mt_r2iq.h"
+
+#include "CppUnitTestFramework.hpp"
+#include <vector>
+
+namespace {
+    struct ConvertFixture {};
+}
+
+TEST_CASE(ConvertFixture, ConvertTest)
+{
+    // odd size and offset to cover the scalar tail and unaligned loads
+    const int size = 1000 + 7;
+    std::vector<int16_t> input(size + 1);
+    for (int i = 0; i <= size; i++)
+        input[i] = (int16_t)(i * 2654435761u >> 16);
+    input[1] = -32768;
+    input[2] = 32767;
+    input[3] = -1;
+
+    std::vector<float> ref(size), out(size), outDispatched(size);
+    auto convert = fft_mt_r2iq::getConvertFloat();
+
+    convert_float_ref<false>(&input[1], ref.data(), size);
+    convert_float<false>(&input[1], out.data(), size);
+    convert(&input[1], outDispatched.data(), size, false);
+    for (int i = 0; i < size; i++)
+    {
+        REQUIRE_EQUAL(out[i], ref[i]);
+        REQUIRE_EQUAL(outDispatched[i], ref[i]);
+    }
+
+    convert_float_ref<true>(&input[1], ref.data(), size);
+    convert_float<true>(&input[1], out.data(), size);
+    convert(&input[1], outDispatched.data(), size, true);
+    for (int i = 0; i < size; i++)
+    {
+        REQUIRE_EQUAL(out[i], ref[i]);
+        REQUIRE_EQUAL(outDispatched[i], ref[i]);
+    }
+}
+
+TEST_CASE(ConvertFixture, PowerTest)
+{
+    // odd count and offset to cover the scalar tail and unaligned loads
+    const int count = 1000 + 7;
+    std::vector<float> input(2 * count + 1);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = (float)(int16_t)(i * 2654435761u >> 16);
+
+    std::vector<float> ref(count), out(count);
+    accumulate_power_ref<false>(&input[1], ref.data(), count);
+    accumulate_power<false>(&input[1], out.data(), count);
+    for (int k = 0; k < count; k++)
+        REQUIRE_EQUAL(out[k], ref[k]);
+
+    accumulate_power_ref<true>(&input[0], ref.data(), count);
+    accumulate_power<true>(&input[0], out.data(), count);
+    for (int k = 0; k < count; k++)
+        REQUIRE_EQUAL(out[k], ref[k]);
+}
@@ -4,9 +4,12 @@
 #include <thread>
 #include <chrono>
 #include <vector>
+#include <complex>
+#include <math.h>
 #include <inttypes.h>  // For portable 64-bit type printf codes
 
 #include "RadioHandler.h"
+#include "fft_mt_r2iq.h"
 
 using namespace std::chrono;
 
@@ -179,6 +182,359 @@ TEST_CASE(CoreFixture, TuneTest)
     radio->Stop();
 
 
+    delete radio;
+    delete usb;
+}
+
+TEST_CASE(CoreFixture, R2IQThreadsTest)
+{
+    const int blocks = 32;
+    const int decimate = 2;
+    ringbuffer<int16_t> input;
+    ringbuffer<float> output;
+    input.setBlockSize(transferSamples);
+    output.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+
+    // some noise in all blocks, the producer just hands them over again
+    uint32_t seed = 1;
+    for (int i = 0; i < input.getCount(); i++)
+    {
+        auto ptr = input.peekWritePtr(i);
+        for (uint32_t k = 0; k < transferSamples; k++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            ptr[k] = (int16_t)(seed >> 16) >> 4;
+        }
+    }
+
+    auto r2iq = new fft_mt_r2iq();
+    r2iq->Init(1.0f, &input, &output);
+    r2iq->setDecimate(decimate);
+    r2iq->setFreqOffset(0.1234f);
+
+    // the threads convert their own fft windows: any number of them has to give
+    //   all the output blocks, and the same samples as a single one
+    std::vector<float> single;
+    for (unsigned threads = 1; threads <= N_MAX_R2IQ_THREADS; threads++)
+    {
+        input.Reset();
+        output.Reset();
+        r2iq->setThreads(threads);
+        r2iq->TurnOn();
+
+        auto producer = std::thread([&input]() {
+            for (int i = 0; i < blocks; i++)
+            {
+                input.getWritePtr();
+                input.WriteDone();
+            }
+        });
+
+        std::vector<float> samples;
+        for (int i = 0; i < (blocks >> decimate); i++)
+        {
+            auto ptr = output.getReadPtr();
+            samples.insert(samples.end(), ptr, ptr + EXT_BLOCKLEN * 2);
+            output.ReadDone();
+        }
+
+        r2iq->TurnOff();
+        producer.join();
+
+        if (threads == 1)
+        {
+            single = samples;
+            continue;
+        }
+        float peak = 0.0f, err = 0.0f;
+        for (size_t k = 0; k < samples.size(); k++)
+        {
+            peak = std::max(peak, fabsf(single[k]));
+            err = std::max(err, fabsf(samples[k] - single[k]));
+        }
+        REQUIRE_TRUE(peak > 0.0f);
+        REQUIRE_TRUE(err <= 1e-5f * peak);
+    }
+
+    delete r2iq;
+}
+
+TEST_CASE(CoreFixture, R2IQChannelTest)
+{
+    const int blocks = 32;
+    ringbuffer<int16_t> input;
+    ringbuffer<float> output, output1, output2;
+    input.setBlockSize(transferSamples);
+    output.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+    output1.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+    output2.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+
+    uint32_t seed = 1;
+    for (int i = 0; i < input.getCount(); i++)
+    {
+        auto ptr = input.peekWritePtr(i);
+        for (uint32_t k = 0; k < transferSamples; k++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            ptr[k] = (int16_t)(seed >> 16) >> 4;
+        }
+    }
+
+    auto r2iq = new fft_mt_r2iq();
+    r2iq->Init(1.0f, &input, &output);
+    r2iq->setDecimate(2);
+    r2iq->setFreqOffset(0.1234f);
+
+    // channel 1 the same as the main output, channel 2 with its own decimation
+    int ch1 = r2iq->AddChannel(&output1, 2);
+    int ch2 = r2iq->AddChannel(&output2, 0);
+    REQUIRE_EQUAL(ch1, 1);
+    REQUIRE_EQUAL(ch2, 2);
+    r2iq->setChannelFreqOffset(ch1, 0.1234f);
+    r2iq->setChannelFreqOffset(ch2, 0.3f);
+
+    r2iq->TurnOn();
+    REQUIRE_EQUAL(r2iq->AddChannel(&output2, 0), -1);
+
+    auto producer = std::thread([&input]() {
+        for (int i = 0; i < blocks; i++)
+        {
+            input.getWritePtr();
+            input.WriteDone();
+        }
+    });
+
+    int count2 = 0;
+    auto consumer2 = std::thread([&output2, &count2]() {
+        for (int i = 0; i < blocks; i++)
+        {
+            output2.getReadPtr();
+            output2.ReadDone();
+            count2++;
+        }
+    });
+
+    for (int i = 0; i < (blocks >> 2); i++)
+    {
+        auto main = output.getReadPtr();
+        auto other = output1.getReadPtr();
+        REQUIRE_EQUAL(memcmp(main, other, EXT_BLOCKLEN * 2 * sizeof(float)), 0);
+        output.ReadDone();
+        output1.ReadDone();
+    }
+    consumer2.join();
+    REQUIRE_EQUAL(count2, blocks);
+
+    r2iq->TurnOff();
+    producer.join();
+
+    r2iq->RemoveChannel(ch1);
+    REQUIRE_EQUAL(r2iq->AddChannel(&output1, 1), ch1);
+
+    delete r2iq;
+}
+
+TEST_CASE(CoreFixture, R2IQFftSizeTest)
+{
+    const int blocks = 24;
+    const int decimate = 2;
+    ringbuffer<int16_t> input;
+    ringbuffer<float> output;
+    input.setBlockSize(transferSamples);
+    output.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+
+    // a tone with whole periods per block, 0.05 above the tuning offset ~0.3 (of fs / 2),
+    //   which is exact as float, but not a bin of any fft size
+    const double offset = 314573.0 / (1 << 20);
+    const double ftone = floor((offset + 0.05) / 2 * transferSamples) / transferSamples;
+    const double fout = (ftone * 2 - offset) * (1 << decimate);
+    for (int i = 0; i < input.getCount(); i++)
+    {
+        auto ptr = input.peekWritePtr(i);
+        for (uint32_t k = 0; k < transferSamples; k++)
+            ptr[k] = (int16_t)(8000 * cos(2 * M_PI * ftone * k));
+    }
+
+    auto r2iq = new fft_mt_r2iq();
+    REQUIRE_EQUAL(r2iq->getFftSize(), 2048);     // no channel in use yet
+    REQUIRE_FALSE(r2iq->setFftSize(4096));
+    REQUIRE_FALSE(r2iq->setFftSize(1024));
+    REQUIRE_FALSE(r2iq->setFftSize(4 * transferSamples));
+
+    r2iq->Init(1.0f, &input, &output);
+
+    // by default the smallest size with room for the filter (see DecimationFilterTaps())
+    const int autoSizes[NDECIDX] = { 2048, 2048, 2048, 8192, 8192, 32768, 32768 };
+    for (int d = 0; d < NDECIDX; d++)
+    {
+        r2iq->setDecimate(d);
+        CHECK_EQUAL(r2iq->getFftSize(), autoSizes[d]);
+    }
+
+    r2iq->setDecimate(decimate);
+    r2iq->setFreqOffset((float)offset);
+
+    // the same tone with every fft size, only the filters' sharpness differs
+    double amplitude = 0;
+    for (int size : { 8192, 2048, 32768, 131072 })
+    {
+        REQUIRE_TRUE(r2iq->setFftSize(size));
+        REQUIRE_EQUAL(r2iq->getFftSize(), size);
+
+        input.Reset();
+        output.Reset();
+        r2iq->TurnOn();
+        REQUIRE_FALSE(r2iq->setFftSize(8192));
+
+        auto producer = std::thread([&input]() {
+            for (int i = 0; i < blocks; i++)
+            {
+                input.getWritePtr();
+                input.WriteDone();
+            }
+        });
+
+        // skip the first block, fit the tone to the rest
+        std::vector<std::complex<double>> iq;
+        for (int i = 0; i < (blocks >> decimate); i++)
+        {
+            auto ptr = output.getReadPtr();
+            for (int n = 0; i > 0 && n < EXT_BLOCKLEN; n++)
+                iq.push_back(std::complex<double>(ptr[2 * n], ptr[2 * n + 1]));
+            output.ReadDone();
+        }
+
+        r2iq->TurnOff();
+        producer.join();
+
+        std::complex<double> fit = 0;
+        for (size_t n = 0; n < iq.size(); n++)
+            fit += iq[n] * std::polar(1.0, -2 * M_PI * fout * n);
+        fit /= (double)iq.size();
+
+        double err = 0;
+        for (size_t n = 0; n < iq.size(); n++)
+            err += norm(iq[n] - fit * std::polar(1.0, 2 * M_PI * fout * n));
+        err /= (double)iq.size();
+
+        if (amplitude == 0)
+            amplitude = abs(fit);
+        CHECK_TRUE(fabs(abs(fit) / amplitude - 1.0) < 0.01);
+        CHECK_TRUE(10 * log10(err / norm(fit)) < -55.0);
+        printf("fft size %d: amplitude %f, error %.1f dB\n", size, abs(fit), 10 * log10(err / norm(fit)));
+    }
+
+    delete r2iq;
+}
+
+static std::vector<float> spectrumPower;
+static int spectrumCount;
+
+static void SpectrumCallback(void* context, const float* power, int bins)
+{
+    if (spectrumCount++ == 0)
+        spectrumPower.assign(power, power + bins);
+    *(int*)context = bins;
+}
+
+TEST_CASE(CoreFixture, R2IQSpectrumTest)
+{
+    const int blocks = 16;
+    const int bins = 256;
+    ringbuffer<int16_t> input;
+    ringbuffer<float> output;
+    input.setBlockSize(transferSamples);
+    output.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+
+    // a tone right in the middle of spectrum bin 100
+    const double ftone = 100.5 / (2 * bins);
+    const double amplitude = 8000;
+    for (int i = 0; i < input.getCount(); i++)
+    {
+        auto ptr = input.peekWritePtr(i);
+        for (uint32_t k = 0; k < transferSamples; k++)
+            ptr[k] = (int16_t)(amplitude * cos(2 * M_PI * ftone * (i * transferSamples + k)));
+    }
+
+    auto r2iq = new fft_mt_r2iq();
+    r2iq->Init(1.0f, &input, &output);
+    int delivered = 0;
+    REQUIRE_FALSE(r2iq->setSpectrum(100, 4, 2, SpectrumCallback, &delivered));
+    REQUIRE_FALSE(r2iq->setSpectrum(bins, 0, 2, SpectrumCallback, &delivered));
+    // more frames than an interval has: all of them
+    REQUIRE_TRUE(r2iq->setSpectrum(bins, 1000, 2, SpectrumCallback, &delivered));
+
+    spectrumCount = 0;
+    r2iq->TurnOn();
+    auto producer = std::thread([&input]() {
+        for (int i = 0; i < blocks; i++)
+        {
+            input.getWritePtr();
+            input.WriteDone();
+        }
+    });
+    for (int i = 0; i < blocks; i++)
+    {
+        output.getReadPtr();
+        output.ReadDone();
+    }
+    r2iq->TurnOff();
+    producer.join();
+
+    // one spectrum for every second input buffer, as the buffer's output is complete
+    REQUIRE_EQUAL(spectrumCount, blocks / 2);
+    REQUIRE_EQUAL(delivered, bins);
+
+    // the tone's power (amplitude / 2)^2 in its bin, the rest far below
+    //   (no window: what leaks stays within a few bins)
+    const double tone = amplitude * amplitude / 4;
+    CHECK_TRUE(spectrumPower[100] > 0.8 * tone && spectrumPower[100] < 1.01 * tone);
+    for (int b = 0; b < bins; b++)
+    {
+        if (b < 95 || b > 105)
+            CHECK_TRUE(spectrumPower[b] < 1e-3 * tone);
+    }
+    printf("spectrum: tone %.1f dB, bin 50 %.1f dB\n", 10 * log10(spectrumPower[100] / tone), 10 * log10(spectrumPower[50] / tone));
+
+    // off again
+    REQUIRE_TRUE(r2iq->setSpectrum(0, 0, 0, nullptr, nullptr));
+    delete r2iq;
+}
+
+static uint32_t channelCount;
+
+static void ChannelCallback(void* context, const float* data, uint32_t len)
+{
+    channelCount++;
+    *(uint64_t*)context += len;
+}
+
+TEST_CASE(CoreFixture, ChannelTest)
+{
+    auto usb = new fx3handler();
+
+    auto radio = new RadioHandlerClass();
+
+    radio->Init(usb, Callback);
+
+    uint64_t channelSize = 0;
+    int ch = radio->AddChannel(0, ChannelCallback, &channelSize);
+    REQUIRE_TRUE(ch > 0);
+    REQUIRE_EQUAL(radio->TuneChannel(ch, 7000000), 7000000u);
+
+    count = 0;
+    channelCount = 0;
+    radio->Start(1);
+    REQUIRE_EQUAL(radio->AddChannel(0, ChannelCallback, &channelSize), -1);
+    std::this_thread::sleep_for(1s);
+    radio->Stop();
+
+    REQUIRE_TRUE(count > 0);
+    REQUIRE_TRUE(channelCount > 0);
+    REQUIRE_EQUAL(channelSize / channelCount, (uint64_t)EXT_BLOCKLEN);
+    REQUIRE_TRUE(radio->RemoveChannel(ch));
+    REQUIRE_TRUE(!radio->RemoveChannel(ch));
+
     delete radio;
     delete usb;
 }
@@ -0,0 +1,75 @@
+#include "fftw_cache.h"
+#include "fft_mt_r2iq.h"
+
+#include "CppUnitTestFramework.hpp"
+#include "testdir.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // a cache of its own, before anything asks for WisdomPath()
+    struct FftwCacheFixture {
+        FftwCacheFixture() :
+            cache("fftw_cache_test"),
+            env("SDDC_CACHE_DIR", cache.path.string()),
+            dir(cache.path)
+        {
+        }
+
+        testdir cache;
+        scopedenv env;
+        fs::path dir;
+    };
+}
+
+TEST_CASE(FftwCacheFixture, WisdomCacheTest)
+{
+    const fs::path path = WisdomPath();
+    REQUIRE_TRUE(path.parent_path() == dir);
+    REQUIRE_EQUAL(path.filename().string().rfind("fftwf-wisdom-v1-", 0), (size_t)0);
+
+    ringbuffer<int16_t> input;
+    ringbuffer<float> output;
+    input.setBlockSize(transferSamples);
+    output.setBlockSize(EXT_BLOCKLEN * 2 * sizeof(float));
+
+    // nothing cached yet: Init() plans the forward fft, TurnOn() the decimation's inverse one
+    auto r2iq = new fft_mt_r2iq();
+    r2iq->Init(1.0f, &input, &output);
+    REQUIRE_FALSE(fs::exists(path));
+    r2iq->setDecimate(2);
+    r2iq->TurnOn();
+    r2iq->TurnOff();
+    REQUIRE_TRUE(fs::exists(path));
+    CHECK_TRUE(r2iq->getSetupTime() > 0.0f);
+
+    // written in one piece: no temporary file left (besides it, the filters are cached)
+    int files = 0;
+    for (auto& entry : fs::directory_iterator(dir))
+    {
+        CHECK_TRUE(entry.path().extension() != ".tmp");
+        if (entry.path().filename().string().rfind("fftwf-", 0) == 0)
+            files++;
+    }
+    CHECK_EQUAL(files, 1);
+
+    // nothing new to save for the same plans
+    {
+        std::lock_guard<std::mutex> lk(FftwPlannerLock());
+        CHECK_FALSE(WisdomSave());
+    }
+    delete r2iq;
+
+    // a second instance in the same process shares the wisdom
+    r2iq = new fft_mt_r2iq();
+    r2iq->Init(1.0f, &input, &output);
+    r2iq->setDecimate(2);
+    r2iq->TurnOn();
+    r2iq->TurnOff();
+    {
+        std::lock_guard<std::mutex> lk(FftwPlannerLock());
+        CHECK_FALSE(WisdomSave());
+    }
+    delete r2iq;
+}
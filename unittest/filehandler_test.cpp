@@ -0,0 +1,516 @@
+#include "FX3FileHandler.h"
+#include "RadioHandler.h"
+#include "fft_mt_r2iq.h"
+
+#include "CppUnitTestFramework.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+using namespace std::chrono;
+
+namespace {
+    struct FileHandlerFixture {
+        FileHandlerFixture() : filename("filehandler_test.raw") {}
+        ~FileHandlerFixture() { remove(filename); }
+
+        void write(const std::vector<int16_t>& samples)
+        {
+            FILE* fp = fopen(filename, "wb");
+            fwrite(samples.data(), sizeof(int16_t), samples.size(), fp);
+            fclose(fp);
+        }
+
+        const char* filename;
+    };
+
+    uint32_t blockCount;
+    uint64_t blockHash;
+
+    void HashCallback(void* context, const float* data, uint32_t len)
+    {
+        // FNV-1a over the output
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < len * 2 * sizeof(float); i++)
+            blockHash = (blockHash ^ bytes[i]) * 0x100000001b3ull;
+        blockCount++;
+    }
+}
+
+TEST_CASE(FileHandlerFixture, FileReplayTest)
+{
+    // three and a half blocks: the last one gets padded
+    const int blocks = 4;
+    std::vector<int16_t> samples(transferSamples * 7 / 2);
+    for (size_t i = 0; i < samples.size(); i++)
+        samples[i] = (int16_t)(i * 7);
+    write(samples);
+
+    REQUIRE_TRUE(CreateFileHandler("does/not/exist.raw", 0, false) == nullptr);
+
+    auto file = new fx3filehandler(filename, 0, false);
+    REQUIRE_TRUE(file->IsOpen());
+    REQUIRE_EQUAL(file->getSampleCount(), (uint64_t)samples.size());
+
+    ringbuffer<int16_t> input;
+    input.setBlockSize(transferSamples);
+    file->StartStream(input, QUEUE_SIZE);
+
+    for (int b = 0; b < blocks; b++)
+    {
+        auto ptr = input.getReadPtr();
+        for (uint32_t k = 0; k < transferSamples; k++)
+        {
+            size_t i = b * transferSamples + k;
+            REQUIRE_EQUAL(ptr[k], i < samples.size() ? samples[i] : (int16_t)0);
+        }
+        input.ReadDone();
+    }
+
+    for (int i = 0; i < 100 && !file->Finished(); i++)
+        std::this_thread::sleep_for(10ms);
+    REQUIRE_TRUE(file->Finished());
+    file->StopStream();
+
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FilePacedTest)
+{
+    std::vector<int16_t> samples(transferSamples);
+    write(samples);
+
+    // 10 ms per block
+    auto file = new fx3filehandler(filename, transferSamples * 100, true);
+    ringbuffer<int16_t> input;
+    input.setBlockSize(transferSamples);
+
+    auto start = steady_clock::now();
+    file->StartStream(input, QUEUE_SIZE);
+    for (int b = 0; b < 11; b++)
+    {
+        input.getReadPtr();
+        input.ReadDone();
+    }
+    duration<double, std::milli> elapsed = steady_clock::now() - start;
+    CHECK_TRUE(elapsed.count() >= 90.0);
+
+    // paced, it is far from filling the inputbuffer
+    file->StopStream();
+
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FileOverflowTest)
+{
+    // nobody reads: the ring (7 blocks) overflows
+    const int blocks = 20;
+    std::vector<int16_t> samples(transferSamples * blocks);
+    for (size_t i = 0; i < samples.size(); i++)
+        samples[i] = (int16_t)(i / transferSamples);
+    write(samples);
+
+    {
+        auto file = new fx3filehandler(filename, 0, false);
+        ringbuffer<int16_t> input(8);
+        input.setBlockSize(transferSamples);
+        file->SetOverflowPolicy(overflow_drop_newest);
+        file->StartStream(input, QUEUE_SIZE);
+        for (int i = 0; i < 100 && !file->Finished(); i++)
+            std::this_thread::sleep_for(10ms);
+        REQUIRE_TRUE(file->Finished());
+        file->StopStream();
+
+        // the first ones stay, the rest is counted as lost
+        REQUIRE_EQUAL(input.available(), 7);
+        CHECK_EQUAL(input.getLostCount(), (uint64_t)(blocks - 7));
+        for (int b = 0; b < 7; b++)
+        {
+            CHECK_EQUAL(input.getReadSequence(), (uint64_t)b);
+            CHECK_EQUAL(input.getReadPtr()[0], (int16_t)b);
+            input.ReadDone();
+        }
+        delete file;
+    }
+
+    {
+        auto file = new fx3filehandler(filename, 0, false);
+        ringbuffer<int16_t> input(8);
+        input.setBlockSize(transferSamples);
+        file->SetOverflowPolicy(overflow_drop_oldest);
+        file->StartStream(input, QUEUE_SIZE);
+        for (int i = 0; i < 100 && !file->Finished(); i++)
+            std::this_thread::sleep_for(10ms);
+        REQUIRE_TRUE(file->Finished());
+        file->StopStream();
+
+        // the queued blocks are stale: skipped by the reader. the newest one
+        //   waits aside, for the room that makes
+        REQUIRE_EQUAL(input.available(), 7);
+        CHECK_TRUE(input.DiscardPending());
+        CHECK_EQUAL(input.Discard(), 7);
+        CHECK_EQUAL(input.available(), 0);
+        REQUIRE_TRUE(input.FlushPending());
+        REQUIRE_EQUAL(input.available(), 1);
+        CHECK_EQUAL(input.getReadSequence(), (uint64_t)(blocks - 1));
+        CHECK_EQUAL(input.getReadPtr()[0], (int16_t)(blocks - 1));
+        CHECK_EQUAL(input.getLostCount(), (uint64_t)(blocks - 1));
+        delete file;
+    }
+}
+
+TEST_CASE(FileHandlerFixture, FileRadioTest)
+{
+    // the same recording has to give the same output, run after run
+    const uint32_t blocks = 16;
+    std::vector<int16_t> samples(transferSamples * blocks);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        samples[i] = (int16_t)(seed >> 16) >> 4;
+    }
+    write(samples);
+
+    auto file = CreateFileHandler(filename, 0, false);
+    REQUIRE_TRUE(file != nullptr);
+
+    auto radio = new RadioHandlerClass();
+    radio->Init(file, HashCallback);
+    REQUIRE_EQUAL(radio->getName(), "Dummy");
+    radio->TuneLO(5000000);
+
+    uint64_t hashes[2];
+    for (int run = 0; run < 2; run++)
+    {
+        blockCount = 0;
+        blockHash = 0xcbf29ce484222325ull;
+        radio->Start(4);    // no decimation: one output block per input block
+        for (int i = 0; i < 500 && blockCount < blocks; i++)
+            std::this_thread::sleep_for(10ms);
+        radio->Stop();
+
+        REQUIRE_EQUAL(blockCount, blocks);
+        hashes[run] = blockHash;
+    }
+    REQUIRE_EQUAL(hashes[0], hashes[1]);
+
+    delete radio;
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FileQueueDepthTest)
+{
+    // the smallest output queue, with all the r2iq threads reserving output
+    //   blocks ahead of the oldest one in work: none of them may wait forever
+    const uint32_t blocks = 16;
+    std::vector<int16_t> samples(transferSamples * blocks);
+    uint32_t seed = 3;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        samples[i] = (int16_t)(seed >> 16) >> 4;
+    }
+    write(samples);
+
+    auto file = CreateFileHandler(filename, 0, false);
+    REQUIRE_TRUE(file != nullptr);
+
+    auto r2iq = new fft_mt_r2iq();
+    auto radio = new RadioHandlerClass();
+    radio->Init(file, HashCallback, r2iq);
+    r2iq->setThreads(N_MAX_R2IQ_THREADS);
+    radio->TuneLO(5000000);
+    REQUIRE_TRUE(radio->SetQueueDepth(MIN_QUEUE_DEPTH));
+
+    blockCount = 0;
+    blockHash = 0xcbf29ce484222325ull;
+    radio->Start(4);    // no decimation: one output block per input block
+    for (int i = 0; i < 500 && blockCount < blocks; i++)
+        std::this_thread::sleep_for(10ms);
+    radio->Stop();
+    REQUIRE_EQUAL(blockCount, blocks);
+
+    delete radio;
+    delete r2iq;
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FilePullTest)
+{
+    // the blocks pulled out of the ring are the ones a callback gets
+    const uint32_t blocks = 16;
+    std::vector<int16_t> samples(transferSamples * blocks);
+    uint32_t seed = 7;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        samples[i] = (int16_t)(seed >> 16) >> 4;
+    }
+    write(samples);
+
+    auto file = CreateFileHandler(filename, 0, false);
+    REQUIRE_TRUE(file != nullptr);
+
+    auto radio = new RadioHandlerClass();
+    radio->Init(file, HashCallback);
+    radio->TuneLO(5000000);
+    blockCount = 0;
+    blockHash = 0xcbf29ce484222325ull;
+    radio->Start(4);
+    for (int i = 0; i < 500 && blockCount < blocks; i++)
+        std::this_thread::sleep_for(10ms);
+    radio->Stop();
+    REQUIRE_EQUAL(blockCount, blocks);
+    const uint64_t pushed = blockHash;
+    delete radio;
+
+    radio = new RadioHandlerClass();
+    radio->Init(file, nullptr);
+    radio->TuneLO(5000000);
+    blockCount = 0;
+    blockHash = 0xcbf29ce484222325ull;
+    radio->Start(4);
+    REQUIRE_TRUE(radio->BlocksReady() >= 0);
+    for (uint32_t b = 0; b < blocks; b++)
+    {
+        uint32_t len;
+        uint64_t sequence;
+        const float* data = radio->AcquireBlock(&len, &sequence);
+        REQUIRE_TRUE(data != nullptr);
+        CHECK_EQUAL(sequence, (uint64_t)b);
+
+        // one at a time
+        uint32_t len2;
+        CHECK_TRUE(radio->AcquireBlock(&len2, &sequence) == nullptr);
+
+        HashCallback(nullptr, data, len);
+        radio->ReleaseBlock();
+    }
+    radio->Stop();
+    REQUIRE_EQUAL(radio->BlocksReady(), -1);
+
+    uint32_t len;
+    uint64_t sequence;
+    CHECK_TRUE(radio->AcquireBlock(&len, &sequence) == nullptr);
+    CHECK_EQUAL(blockHash, pushed);
+
+    delete radio;
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FileStampTest)
+{
+    // decimated by 4: an output block out of 4 input blocks, 32768 samples each
+    std::vector<int16_t> samples(transferSamples * 4);
+    write(samples);
+
+    auto file = CreateFileHandler(filename, 0, true);
+    REQUIRE_TRUE(file != nullptr);
+
+    auto radio = new RadioHandlerClass();
+    radio->Init(file, nullptr);
+    radio->Start(2);
+    uint64_t time = 0;
+    for (uint32_t b = 0; b < 8; b++)
+    {
+        uint32_t len;
+        uint64_t sequence;
+        REQUIRE_TRUE(radio->AcquireBlock(&len, &sequence) != nullptr);
+        REQUIRE_EQUAL(len, (uint32_t)EXT_BLOCKLEN);
+
+        // contiguous, in the output's samples
+        const blockstamp stamp = radio->GetStamp();
+        CHECK_EQUAL(stamp.sample, (uint64_t)b * EXT_BLOCKLEN);
+        CHECK_TRUE(stamp.time > 0 && stamp.time >= time);
+        time = stamp.time;
+        radio->ReleaseBlock();
+    }
+    radio->Stop();
+
+    delete radio;
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FileMetricsTest)
+{
+    std::vector<int16_t> samples(transferSamples * 4);
+    write(samples);
+
+    auto file = CreateFileHandler(filename, 0, true);
+    REQUIRE_TRUE(file != nullptr);
+
+    auto radio = new RadioHandlerClass();
+    radio->Init(file, HashCallback);
+    blockCount = 0;
+    radio->Start(4);
+    for (int i = 0; i < 500 && blockCount < 32; i++)
+        std::this_thread::sleep_for(10ms);
+    const pipelinemetrics m = radio->GetMetrics();
+    radio->Stop();
+    REQUIRE_TRUE(blockCount >= 32);
+
+    // at least what the callback got came in
+    CHECK_TRUE(m.usbBytes >= 32 * transferSize);
+    CHECK_EQUAL(m.usbBytes % transferSize, 0u);
+    CHECK_TRUE(m.input.highWater > 0 && m.input.highWater < m.input.blocks);
+    CHECK_TRUE(m.output.highWater > 0 && m.output.highWater < m.output.blocks);
+    CHECK_EQUAL(m.input.lost, 0u);
+
+    for (auto v : { m.r2iqBlock, m.callback })
+    {
+        CHECK_TRUE(v.count >= 32);
+        uint64_t sum = 0;
+        for (int b = 0; b < timehistogram::buckets; b++)
+            sum += v.counts[b];
+        CHECK_EQUAL(sum, v.count);
+        CHECK_TRUE(v.max * v.count >= v.total);
+        CHECK_TRUE(timehistogram::Percentile(v, 0.5) <= timehistogram::Percentile(v, 0.99));
+    }
+
+    delete radio;
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FileRawTest)
+{
+    // raw mode: the blocks as they come, r2iq stays off
+    const uint32_t blocks = 12;
+    std::vector<int16_t> samples(transferSamples * blocks);
+    for (size_t i = 0; i < samples.size(); i++)
+        samples[i] = (int16_t)(i * 3);
+    write(samples);
+
+    auto file = CreateFileHandler(filename, 0, false);
+    REQUIRE_TRUE(file != nullptr);
+
+    struct rawCapture {
+        std::vector<int16_t> samples;
+        uint32_t calls;
+    } capture = { {}, 0 };
+
+    auto radio = new RadioHandlerClass();
+    radio->Init(file, HashCallback);
+    REQUIRE_TRUE(radio->SetRawCallback(
+        [](void* context, const int16_t* data, uint32_t len) {
+            auto c = (rawCapture*)context;
+            c->samples.insert(c->samples.end(), data, data + len);
+            c->calls++;
+        }, &capture));
+    REQUIRE_FALSE(radio->SetQueueDepth(2));
+    REQUIRE_FALSE(radio->SetQueueDepth(MIN_QUEUE_DEPTH - 1));
+    REQUIRE_TRUE(radio->SetQueueDepth(8));
+
+    blockCount = 0;
+    radio->Start(4);
+    REQUIRE_FALSE(radio->SetRawCallback(nullptr));
+    for (int i = 0; i < 500 && capture.calls < blocks; i++)
+        std::this_thread::sleep_for(10ms);
+    radio->Stop();
+
+    REQUIRE_EQUAL(capture.calls, blocks);
+    CHECK_TRUE(capture.samples == samples);
+    CHECK_EQUAL(blockCount, 0u);
+
+    delete radio;
+    delete file;
+}
+
+TEST_CASE(FileHandlerFixture, FileDevicesTest)
+{
+    // two devices at once: each keeps its rate and its output is the one it
+    //   gives alone
+    const uint32_t blocks = 16;
+    const char* filenames[2] = { filename, "filehandler_test2.raw" };
+    std::vector<int16_t> samples(transferSamples * blocks);
+    for (int d = 0; d < 2; d++)
+    {
+        uint32_t seed = d + 1;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            samples[i] = (int16_t)(seed >> 16) >> 4;
+        }
+        FILE* fp = fopen(filenames[d], "wb");
+        fwrite(samples.data(), sizeof(int16_t), samples.size(), fp);
+        fclose(fp);
+    }
+
+    struct deviceOutput {
+        std::atomic<uint32_t> count;
+        uint64_t hash;
+    } outputs[2];
+
+    auto callback = [](void* context, const float* data, uint32_t len) {
+        auto o = (deviceOutput*)context;
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < len * 2 * sizeof(float); i++)
+            o->hash = (o->hash ^ bytes[i]) * 0x100000001b3ull;
+        o->count++;
+    };
+
+    fx3class* files[2];
+    RadioHandlerClass* radios[2];
+    for (int d = 0; d < 2; d++)
+    {
+        files[d] = CreateFileHandler(filenames[d], 0, false);
+        REQUIRE_TRUE(files[d] != nullptr);
+        radios[d] = new RadioHandlerClass();
+        radios[d]->UpdateSampleRate(d == 0 ? DEFAULT_ADC_FREQ : 50000000);
+        REQUIRE_TRUE(radios[d]->Init(files[d], callback, nullptr, &outputs[d]));
+        radios[d]->TuneLO(5000000);
+    }
+    CHECK_EQUAL(radios[0]->getSampleRate(), DEFAULT_ADC_FREQ);
+    CHECK_EQUAL(radios[1]->getSampleRate(), 50000000u);
+
+    auto run = [&](bool first, bool second) {
+        const bool active[2] = { first, second };
+        for (int d = 0; d < 2; d++)
+        {
+            outputs[d].count = 0;
+            outputs[d].hash = 0xcbf29ce484222325ull;
+            if (active[d])
+                radios[d]->Start(4);
+        }
+        for (int i = 0; i < 500; i++)
+        {
+            bool done = true;
+            for (int d = 0; d < 2; d++)
+                done = done && (!active[d] || outputs[d].count >= blocks);
+            if (done)
+                break;
+            std::this_thread::sleep_for(10ms);
+        }
+        for (int d = 0; d < 2; d++)
+        {
+            if (active[d])
+                radios[d]->Stop();
+        }
+    };
+
+    uint64_t alone[2];
+    for (int d = 0; d < 2; d++)
+    {
+        run(d == 0, d == 1);
+        REQUIRE_EQUAL(outputs[d].count.load(), blocks);
+        CHECK_EQUAL(outputs[1 - d].count.load(), 0u);
+        alone[d] = outputs[d].hash;
+    }
+    CHECK_TRUE(alone[0] != alone[1]);
+
+    run(true, true);
+    for (int d = 0; d < 2; d++)
+    {
+        REQUIRE_EQUAL(outputs[d].count.load(), blocks);
+        CHECK_EQUAL(outputs[d].hash, alone[d]);
+    }
+
+    for (int d = 0; d < 2; d++)
+    {
+        delete radios[d];
+        delete files[d];
+    }
+    remove(filenames[1]);
+}
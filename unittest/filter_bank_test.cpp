@@ -0,0 +1,123 @@
+#include "filter_bank.h"
+#include "fftw_cache.h"
+#include "r2iq.h"
+
+#include "CppUnitTestFramework.hpp"
+#include "testdir.h"
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
+#include <vector>
+#include <stdio.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    // a cache of its own, before anything asks for CacheDirectory()
+    struct FilterBankFixture {
+        FilterBankFixture() :
+            cache("filter_bank_test"),
+            env("SDDC_CACHE_DIR", cache.path.string()),
+            dir(cache.path)
+        {
+        }
+
+        int files()
+        {
+            int count = 0;
+            for (auto& entry : fs::directory_iterator(dir))
+            {
+                CHECK_TRUE(entry.path().extension() != ".tmp");
+                count++;
+            }
+            return count;
+        }
+
+        testdir cache;
+        scopedenv env;
+        fs::path dir;
+    };
+}
+
+TEST_CASE(FilterBankFixture, FilterBankSharedTest)
+{
+    REQUIRE_TRUE(fs::path(CacheDirectory()) == dir);
+
+    // designed once, then shared
+    auto filter = GetDecimationFilter(1.0f, 4096, 2);
+    REQUIRE_TRUE(filter != nullptr);
+    REQUIRE_EQUAL(filter->size, 4096);
+    REQUIRE_TRUE(GetDecimationFilter(1.0f, 4096, 2) == filter);
+    REQUIRE_EQUAL(files(), 1);
+
+    // anything else is another filter
+    auto other = GetDecimationFilter(1.0f, 4096, 3);
+    CHECK_TRUE(other != filter);
+    CHECK_TRUE(GetDecimationFilter(0.5f, 4096, 2) != filter);
+    CHECK_TRUE(GetDecimationFilter(1.0f, 1024, 2) != filter);
+    CHECK_EQUAL(files(), 4);
+
+    // a lowpass: gain at dc, nothing above the passband
+    float dc = filter->Hw[0][0] * filter->Hw[0][0] + filter->Hw[0][1] * filter->Hw[0][1];
+    float stop = filter->Hw[4096 / 4][0] * filter->Hw[4096 / 4][0] + filter->Hw[4096 / 4][1] * filter->Hw[4096 / 4][1];
+    CHECK_TRUE(dc > 0.0f);
+    CHECK_TRUE(stop < dc * 1e-10f);
+}
+
+TEST_CASE(FilterBankFixture, FilterBankCachedTest)
+{
+    const size_t size = sizeof(fftwf_complex) * 2048;
+    std::vector<char> designed(size);
+    {
+        auto filter = GetDecimationFilter(1.0f, 2048, 1);
+        memcpy(designed.data(), filter->Hw, size);
+    }
+    REQUIRE_EQUAL(files(), 1);
+
+    // no one holds it anymore: the next one comes from the cache file
+    auto filter = GetDecimationFilter(1.0f, 2048, 1);
+    CHECK_EQUAL(memcmp(filter->Hw, designed.data(), size), 0);
+    filter.reset();
+
+    // .. which is what gets used
+    const fs::path path = fs::directory_iterator(dir)->path();
+    std::vector<char> zeros(size, 0);
+    FILE* fp = fopen(path.string().c_str(), "wb");
+    fwrite(zeros.data(), 1, size, fp);
+    fclose(fp);
+    filter = GetDecimationFilter(1.0f, 2048, 1);
+    CHECK_EQUAL(memcmp(filter->Hw, zeros.data(), size), 0);
+    filter.reset();
+
+    // a truncated file doesn't
+    fp = fopen(path.string().c_str(), "wb");
+    fwrite(zeros.data(), 1, size / 2, fp);
+    fclose(fp);
+    filter = GetDecimationFilter(1.0f, 2048, 1);
+    CHECK_EQUAL(memcmp(filter->Hw, designed.data(), size), 0);
+}
+
+TEST_CASE(FilterBankFixture, FilterBankStopbandTest)
+{
+    // the stopband from 1.1 times the output's Nyquist on: beyond the input's one without decimation
+    for (int d = 1; d < NDECIDX; d++)
+    {
+        REQUIRE_TRUE(DecimationFilterTaps(d) > DecimationFilterTaps(d - 1));
+        for (int halfFft : { 1024, 4096, 16384, 65536 })
+        {
+            auto filter = GetDecimationFilter(1.0f, halfFft, d);
+            auto power = [&filter](int k) { return filter->Hw[k][0] * filter->Hw[k][0] + filter->Hw[k][1] * filter->Hw[k][1]; };
+            const int stop = (int)ceil(1.1 * 0.5 / (1 << d) * halfFft);
+            float worst = 0.0f;
+            for (int k = stop; k <= halfFft - stop; k++)
+                worst = std::max(worst, power(k));
+            const float attenuation = 10 * log10f(worst / power(0));
+
+            // the overlap has room for all taps: close to the design's 120 dB, float precision permitting
+            if (DecimationFilterTaps(d) <= halfFft / 4 + 1)
+                CHECK_TRUE(attenuation < -110.0f);
+            else
+                CHECK_TRUE(attenuation > -110.0f);
+        }
+    }
+}
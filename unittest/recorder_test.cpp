@@ -0,0 +1,157 @@
+#include "RawRecorder.h"
+#include "config.h"
+
+#include "CppUnitTestFramework.hpp"
+#include "testdir.h"
+#include <filesystem>
+#include <fstream>
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct RecorderFixture {
+        RecorderFixture() : recordings("recorder_test"), dir(recordings.path)
+        {
+            info.sampleRate = 64000000;
+            info.frequency = 0;
+            info.hardware = "RX888 mkII";
+            info.rfMode = "HF";
+            info.rfGain = -10.0f;
+            info.ifGain = 20.5f;
+            info.dither = true;
+            info.random = false;
+        }
+        // block i: i * 7 + sample index, wrapped
+        static void fill(std::vector<int16_t>& block, int i)
+        {
+            for (size_t k = 0; k < block.size(); k++)
+                block[k] = (int16_t)(i * 7 + k);
+        }
+
+        std::string file(int index, const char* extension)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "rec-%04d", index);
+            return (dir / (name + std::string(extension))).string();
+        }
+
+        std::string read(const std::string& path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            std::stringstream text;
+            text << in.rdbuf();
+            return text.str();
+        }
+
+        testdir recordings;
+        fs::path dir;
+        rawrecorder::info info;
+    };
+}
+
+TEST_CASE(RecorderFixture, RecorderWriteTest)
+{
+    const size_t blockBytes = transferSamples * sizeof(int16_t);
+    std::vector<int16_t> block(transferSamples);
+
+    rawrecorder recorder((dir / "rec").string().c_str());
+    REQUIRE_TRUE(recorder.Start(info));
+    for (int i = 0; i < 10; i++)
+    {
+        fill(block, i);
+        recorder.Write(block.data());
+    }
+    recorder.Stop();
+
+    REQUIRE_EQUAL(recorder.getWritten(), 10u);
+    REQUIRE_EQUAL(recorder.getDropped(), 0u);
+    REQUIRE_FALSE(recorder.getError());
+    REQUIRE_EQUAL(recorder.getFiles(), 1);
+
+    // the blocks as they came, without the preallocated rest
+    const std::string data = read(file(0, ".sigmf-data"));
+    REQUIRE_EQUAL(data.size(), 10 * blockBytes);
+    for (int i = 0; i < 10; i++)
+    {
+        fill(block, i);
+        CHECK_TRUE(memcmp(data.data() + i * blockBytes, block.data(), blockBytes) == 0);
+    }
+
+    const std::string meta = read(file(0, ".sigmf-meta"));
+    CHECK_TRUE(meta.find("\"core:datatype\": \"ri16_le\"") != std::string::npos);
+    CHECK_TRUE(meta.find("\"core:sample_rate\": 64000000") != std::string::npos);
+    CHECK_TRUE(meta.find("\"core:hw\": \"RX888 mkII\"") != std::string::npos);
+    CHECK_TRUE(meta.find("\"core:extensions\": [ { \"name\": \"sddc\"") != std::string::npos);
+    CHECK_TRUE(meta.find("\"sddc:rf_gain\": -10.0") != std::string::npos);
+    CHECK_TRUE(meta.find("\"sddc:if_gain\": 20.5") != std::string::npos);
+    CHECK_TRUE(meta.find("\"core:sample_start\": 0") != std::string::npos);
+    CHECK_TRUE(meta.find("\"core:datetime\": \"20") != std::string::npos);
+    CHECK_FALSE(fs::exists(file(1, ".sigmf-data")));
+}
+
+TEST_CASE(RecorderFixture, RecorderRotateTest)
+{
+    const size_t blockBytes = transferSamples * sizeof(int16_t);
+    std::vector<int16_t> block(transferSamples);
+
+    // 4 blocks per file
+    rawrecorder recorder((dir / "rec").string().c_str(), 4 * blockBytes + 100);
+    REQUIRE_TRUE(recorder.Start(info));
+    for (int i = 0; i < 10; i++)
+    {
+        fill(block, i);
+        recorder.Write(block.data());
+    }
+    recorder.Stop();
+
+    REQUIRE_EQUAL(recorder.getWritten(), 10u);
+    REQUIRE_EQUAL(recorder.getFiles(), 3);
+    CHECK_EQUAL(fs::file_size(file(0, ".sigmf-data")), 4 * blockBytes);
+    CHECK_EQUAL(fs::file_size(file(1, ".sigmf-data")), 4 * blockBytes);
+    CHECK_EQUAL(fs::file_size(file(2, ".sigmf-data")), 2 * blockBytes);
+    CHECK_TRUE(fs::exists(file(2, ".sigmf-meta")));
+
+    // continued where the previous file ended
+    const std::string data = read(file(1, ".sigmf-data"));
+    fill(block, 4);
+    CHECK_TRUE(memcmp(data.data(), block.data(), blockBytes) == 0);
+}
+
+TEST_CASE(RecorderFixture, RecorderOverflowTest)
+{
+    const size_t blockBytes = transferSamples * sizeof(int16_t);
+    std::vector<int16_t> block(transferSamples);
+
+    // a short queue: Write() drops, what does not fit, and never waits
+    rawrecorder recorder((dir / "rec").string().c_str(), 0, 0.0, 4);
+    REQUIRE_TRUE(recorder.Start(info));
+    for (int i = 0; i < 50; i++)
+    {
+        fill(block, i);
+        recorder.Write(block.data());
+    }
+    // one more, once the writer caught up
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    recorder.Write(block.data());
+    recorder.Stop();
+
+    CHECK_EQUAL(recorder.getWritten() + recorder.getDropped(), 51u);
+    CHECK_EQUAL(fs::file_size(file(0, ".sigmf-data")), recorder.getWritten() * blockBytes);
+
+    // a capture segment after each gap
+    const std::string meta = read(file(0, ".sigmf-meta"));
+    size_t captures = 0;
+    for (size_t at = meta.find("core:sample_start"); at != std::string::npos; at = meta.find("core:sample_start", at + 1))
+        captures++;
+    CHECK_TRUE(captures >= 1);
+    if (recorder.getDropped() == 0)
+        CHECK_EQUAL(captures, 1u);
+    else
+        CHECK_TRUE(captures >= 2);
+}
@@ -0,0 +1,86 @@
+#include "resampler.h"
+
+#include "CppUnitTestFramework.hpp"
+#include <complex>
+#include <vector>
+#include <math.h>
+
+namespace {
+    struct ResamplerFixture {};
+
+    // complex tone at freq (relative to the sample rate)
+    std::vector<float> tone(double freq, int count)
+    {
+        std::vector<float> data(2 * count);
+        for (int i = 0; i < count; i++)
+        {
+            data[2 * i] = (float)cos(2 * M_PI * freq * i);
+            data[2 * i + 1] = (float)sin(2 * M_PI * freq * i);
+        }
+        return data;
+    }
+}
+
+TEST_CASE(ResamplerFixture, ResamplerToneTest)
+{
+    // e.g. 2.4 Msps out of 4 Msps
+    const double ratio = 2.4 / 4.0;
+    const double freq = 0.2;        // 800 kHz, inside the output's passband
+    const int count = 32768;
+    auto input = tone(freq, 4 * count);
+
+    resampler resample(ratio);
+    std::vector<std::complex<double>> output;
+    for (int b = 0; b < 4; b++)
+    {
+        auto n = resample.Process(&input[2 * b * count], count);
+        auto out = resample.getOutput();
+        for (uint32_t i = 0; i < n; i++)
+            output.push_back(std::complex<double>(out[2 * i], out[2 * i + 1]));
+    }
+    REQUIRE_TRUE(fabs(output.size() - 4 * count * ratio) <= 1.0);
+
+    // after the filter's delay, it has to be the same tone at the output rate:
+    //   fit its (constant) amplitude and phase, what remains is the error
+    const int skip = 1000;
+    const double fout = freq / ratio;
+    std::complex<double> fit = 0;
+    for (size_t i = skip; i < output.size(); i++)
+        fit += output[i] * std::polar(1.0, -2 * M_PI * fout * i);
+    fit /= (double)(output.size() - skip);
+    CHECK_TRUE(fabs(abs(fit) - 1.0) < 1e-3);
+
+    double err = 0;
+    for (size_t i = skip; i < output.size(); i++)
+        err += norm(output[i] - fit * std::polar(1.0, 2 * M_PI * fout * i));
+    err /= (double)(output.size() - skip);
+    CHECK_TRUE(10 * log10(err) < -70.0);
+}
+
+TEST_CASE(ResamplerFixture, ResamplerBlockTest)
+{
+    // the output must not depend on how the input is split into blocks
+    const double ratio = 3.072 / 4.0;
+    const int count = 10000;
+    auto input = tone(0.05, count);
+
+    resampler whole(ratio);
+    auto n = whole.Process(input.data(), count);
+    std::vector<float> expected(whole.getOutput(), whole.getOutput() + 2 * n);
+
+    resampler split(ratio);
+    std::vector<float> output;
+    const int sizes[] = { 1, 7, 1000, 3, 2500 };
+    int pos = 0;
+    for (int i = 0; pos < count; i++)
+    {
+        int size = std::min(sizes[i % 5], count - pos);
+        auto m = split.Process(&input[2 * pos], size);
+        output.insert(output.end(), split.getOutput(), split.getOutput() + 2 * m);
+        pos += size;
+    }
+
+    REQUIRE_EQUAL(output.size(), expected.size());
+    for (size_t i = 0; i < output.size(); i++)
+        REQUIRE_EQUAL(output[i], expected[i]);
+}
@@ -3,6 +3,8 @@
 #include "CppUnitTestFramework.hpp"
 #include <thread>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 
 using namespace std::chrono;
 
@@ -174,4 +176,221 @@ TEST_CASE(RingBufferFixture, PeekTest)
 
     auto rptr2 = buffer.peekReadPtr(-1);
     CHECK_EQUAL(rptr0, rptr2);
-}
\ No newline at end of file
+}
+TEST_CASE(RingBufferFixture, OffsetTest)
+{
+    auto buffer = ringbuffer<int16_t>(8);
+    buffer.setBlockSize(16);
+
+    // reserve blocks ahead, complete them in order
+    auto wptr0 = buffer.getWritePtr(0);
+    auto wptr2 = buffer.getWritePtr(2);
+    CHECK_EQUAL(wptr2, buffer.peekWritePtr(2));
+    *wptr0 = 0;
+    *wptr2 = 2;
+    *buffer.getWritePtr(1) = 1;
+    buffer.WriteDone();
+    buffer.WriteDone();
+    buffer.WriteDone();
+
+    for (int i = 0; i < 3; i++)
+    {
+        auto rptr = buffer.getReadPtr(i);
+        CHECK_EQUAL(rptr, buffer.peekReadPtr(i));
+        CHECK_EQUAL(*rptr, i);
+    }
+
+    // block 3 is written in another thread
+    auto thread1 = std::thread(
+        [&buffer]() {
+            std::this_thread::sleep_for(10ms);
+            *buffer.getWritePtr() = 3;
+            buffer.WriteDone();
+        });
+
+    CHECK_EQUAL(*buffer.getReadPtr(3), 3);
+    thread1.join();
+}
+
+TEST_CASE(RingBufferFixture, ExternalBlocksTest)
+{
+    auto buffer = ringbuffer<int16_t>(4);
+    buffer.setBlockSize(16);
+
+    std::vector<int16_t> storage(4 * 16);
+    int16_t* blocks[4];
+    for (int i = 0; i < 4; i++)
+        blocks[i] = &storage[i * 16];
+
+    std::vector<int> released;
+    buffer.setBlocks(blocks);
+    buffer.setReleaseCallback(
+        [](void* context, int index) {
+            ((std::vector<int>*)context)->push_back(index);
+        }, &released);
+
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK_EQUAL(buffer.getWritePtr(), blocks[i]);
+        buffer.WriteDone();
+    }
+
+    // the block read before stays valid for the overlap until the next ReadDone()
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK_EQUAL(buffer.getReadPtr(), blocks[i]);
+        buffer.ReadDone();
+        REQUIRE_EQUAL((int)released.size(), i + 1);
+        CHECK_EQUAL(released[i], (i + 3) % 4);
+    }
+
+    buffer.setReleaseCallback(nullptr, nullptr);
+    buffer.setBlocks(nullptr);
+    buffer.Reset();
+    CHECK_TRUE(buffer.getWritePtr() != blocks[0]);
+}
+
+TEST_CASE(RingBufferFixture, ThroughputTest)
+{
+    const int blocks = 200000;
+    auto buffer = ringbuffer<int16_t>(32);
+    buffer.setBlockSize(64);
+
+    auto start = steady_clock::now();
+    auto thread1 = std::thread(
+        [&buffer](){
+            for(int i = 0; i < blocks; i++) {
+                auto ptr = buffer.getWritePtr();
+                *(int32_t*)ptr = i;
+                buffer.WriteDone();
+            }
+        }
+    );
+
+    int errors = 0;
+    for(int i = 0; i < blocks; i++) {
+        auto ptr = buffer.getReadPtr();
+        if (*(const int32_t*)ptr != i)
+            errors++;
+        buffer.ReadDone();
+    }
+    thread1.join();
+    duration<double> elapsed = steady_clock::now() - start;
+
+    printf("ringbuffer throughput: %.0f blocks/s, full waits %d, empty waits %d\n",
+        blocks / elapsed.count(), buffer.getFullCount(), buffer.getEmptyCount());
+    REQUIRE_EQUAL(errors, 0);
+    REQUIRE_EQUAL(buffer.getWriteCount(), (uint64_t)blocks);
+}
+
+TEST_CASE(RingBufferFixture, LatencyTest)
+{
+    // ping-pong a block between two threads, measure the round trip
+    const int rounds = 2000;
+    auto ping = ringbuffer<int16_t>(4);
+    auto pong = ringbuffer<int16_t>(4);
+    ping.setBlockSize(16);
+    pong.setBlockSize(16);
+
+    auto thread1 = std::thread(
+        [&ping, &pong](){
+            for(int i = 0; i < rounds; i++) {
+                auto value = *ping.getReadPtr();
+                ping.ReadDone();
+                *pong.getWritePtr() = value;
+                pong.WriteDone();
+            }
+        }
+    );
+
+    std::vector<double> latency(rounds);
+    for(int i = 0; i < rounds; i++) {
+        auto start = steady_clock::now();
+        *ping.getWritePtr() = (int16_t)i;
+        ping.WriteDone();
+        auto value = *pong.getReadPtr();
+        pong.ReadDone();
+        duration<double, std::micro> elapsed = steady_clock::now() - start;
+        latency[i] = elapsed.count();
+        REQUIRE_EQUAL(value, (int16_t)i);
+    }
+    thread1.join();
+
+    std::sort(latency.begin(), latency.end());
+    printf("ringbuffer round trip: median %.1f us, 99%% %.1f us, max %.1f us\n",
+        latency[rounds / 2], latency[rounds * 99 / 100], latency[rounds - 1]);
+}
+
+TEST_CASE(RingBufferFixture, CountTest)
+{
+    auto buffer = ringbuffer<int16_t>(4);
+    buffer.setBlockSize(16);
+    buffer.getWritePtr();
+    buffer.WriteDone();
+
+    // more blocks, empty again
+    buffer.setCount(8);
+    CHECK_EQUAL(buffer.getCount(), 8);
+    CHECK_EQUAL(buffer.available(), 0);
+    for (int i = 0; i < 7; i++)
+    {
+        int16_t* ptr = buffer.getWritePtr();
+        REQUIRE_TRUE(ptr != nullptr);
+        ptr[15] = (int16_t)i;
+        buffer.WriteDone();
+    }
+    CHECK_EQUAL(buffer.available(), 7);
+    for (int i = 0; i < 7; i++)
+    {
+        CHECK_EQUAL(buffer.getReadPtr()[15], i);
+        buffer.ReadDone();
+    }
+}
+
+TEST_CASE(RingBufferFixture, LostTest)
+{
+    auto buffer = ringbuffer<int16_t>(8);
+    buffer.setBlockSize(16);
+
+    // a lost block leaves a gap in the sequence, a damaged one keeps its place
+    buffer.getWritePtr();
+    buffer.WriteDone();
+    buffer.Lost();
+    buffer.getWritePtr();
+    buffer.Damaged();
+    buffer.WriteDone();
+
+    CHECK_EQUAL(buffer.getLostCount(), 2u);
+    CHECK_EQUAL(buffer.getDroppedCount(), 2u);
+    CHECK_EQUAL(buffer.getReadSequence(0), 0u);
+    CHECK_EQUAL(buffer.getReadSequence(1), 2u);
+}
+
+TEST_CASE(RingBufferFixture, DropOldestTest)
+{
+    auto buffer = ringbuffer<int16_t>(4);
+    buffer.setBlockSize(16);
+    int16_t block[16] = {};
+
+    // full at 3: the 4th block waits aside, the 5th replaces it
+    for (int i = 0; i < 5; i++)
+    {
+        block[0] = (int16_t)i;
+        buffer.WriteDropOldest(block);
+    }
+    CHECK_EQUAL(buffer.available(), 3);
+    CHECK_FALSE(buffer.FlushPending());
+
+    // the reader skips the backlog, then the newest block moves in
+    CHECK_EQUAL(buffer.Discard(), 3);
+    block[0] = 5;
+    buffer.WriteDropOldest(block);
+    REQUIRE_EQUAL(buffer.available(), 2);
+    CHECK_EQUAL(buffer.getReadSequence(0), 4u);
+    CHECK_EQUAL(buffer.getReadSequence(1), 5u);
+    CHECK_EQUAL(buffer.getReadPtr()[0], 4);
+    buffer.ReadDone();
+    CHECK_EQUAL(buffer.getReadPtr()[0], 5);
+    CHECK_EQUAL(buffer.getLostCount(), 4u);
+    CHECK_EQUAL(buffer.getDroppedCount(), 1u);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// a directory of a test case's own, in the temp directory: named after the
+//   case, the process and a counter, so cases running in parallel (ctest -j)
+//   never share or delete each other's files. removed with its content after
+class testdir
+{
+public:
+    testdir(const char* name)
+    {
+        static std::atomic<int> counter(0);
+#ifdef _WIN32
+        const int pid = _getpid();
+#else
+        const int pid = getpid();
+#endif
+        path = std::filesystem::temp_directory_path() /
+            (std::string(name) + "-" + std::to_string(pid) + "-" + std::to_string(counter++));
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+    }
+
+    ~testdir()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+
+    std::filesystem::path path;
+};
+
+// an environment variable for the life of a test case; the old value (or
+//   none) comes back after
+class scopedenv
+{
+public:
+    scopedenv(const char* name, const std::string& value) : name(name)
+    {
+        const char* old = getenv(name);
+        hadValue = old != nullptr;
+        if (hadValue)
+            oldValue = old;
+        set(value.c_str());
+    }
+
+    ~scopedenv()
+    {
+        if (hadValue)
+            set(oldValue.c_str());
+        else
+        {
+#ifdef _WIN32
+            _putenv_s(name.c_str(), "");
+#else
+            unsetenv(name.c_str());
+#endif
+        }
+    }
+
+private:
+    void set(const char* value)
+    {
+#ifdef _WIN32
+        _putenv_s(name.c_str(), value);
+#else
+        setenv(name.c_str(), value, 1);
+#endif
+    }
+
+    std::string name;
+    bool hadValue;
+    std::string oldValue;
+};
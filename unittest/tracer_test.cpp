@@ -0,0 +1,87 @@
+#include "tracer.h"
+
+#include "CppUnitTestFramework.hpp"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <stdio.h>
+
+namespace {
+    struct TracerFixture {
+        TracerFixture() : filename("tracer_test.json") { tracer::Clear(); }
+        ~TracerFixture()
+        {
+            tracer::Enable(false);
+            remove(filename);
+        }
+
+        std::string dump()
+        {
+            REQUIRE_TRUE(tracer::Dump(filename));
+            std::ifstream in(filename);
+            std::stringstream text;
+            text << in.rdbuf();
+            return text.str();
+        }
+
+        static size_t count(const std::string& text, const std::string& what)
+        {
+            size_t n = 0;
+            for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+                n++;
+            return n;
+        }
+
+        const char* filename;
+    };
+}
+
+TEST_CASE(TracerFixture, TraceDumpTest)
+{
+    // off: nothing recorded
+    {
+        tracescope scope("before");
+    }
+
+    tracer::Enable(true);
+    auto worker = std::thread([]() {
+        tracer::SetThreadName("worker");
+        for (int i = 0; i < 10; i++)
+        {
+            tracescope scope("work", i);
+        }
+    });
+    worker.join();
+    {
+        tracescope scope("main", 42);
+    }
+    tracer::Record("manual", 1000, 3000, 7);
+
+    const std::string json = dump();
+    CHECK_TRUE(json.find("\"traceEvents\"") != std::string::npos);
+    CHECK_EQUAL(count(json, "\"name\": \"before\""), 0u);
+    CHECK_EQUAL(count(json, "\"name\": \"work\""), 10u);
+    CHECK_EQUAL(count(json, "\"name\": \"main\""), 1u);
+    CHECK_TRUE(json.find("\"args\": {\"name\": \"worker\"}") != std::string::npos);
+    CHECK_TRUE(json.find("\"dur\": 2.000, \"args\": {\"arg\": 7}") != std::string::npos);
+    CHECK_TRUE(json.find("\"args\": {\"arg\": 42}") != std::string::npos);
+
+    // forgotten after Clear()
+    tracer::Clear();
+    CHECK_EQUAL(count(dump(), "\"ph\": \"X\""), 0u);
+}
+
+TEST_CASE(TracerFixture, TraceWrapTest)
+{
+    // a thread keeps its latest events only
+    tracer::Enable(true);
+    for (int i = 0; i < tracer::events + 10; i++)
+        tracer::Record("event", 1000 * i, 1000 * i + 500, i);
+
+    const std::string json = dump();
+    CHECK_EQUAL(count(json, "\"name\": \"event\""), (size_t)tracer::events);
+    CHECK_TRUE(json.find("{\"arg\": 9}") == std::string::npos);
+    CHECK_TRUE(json.find("{\"arg\": 10}") != std::string::npos);
+    CHECK_TRUE(json.find("{\"arg\": 65545}") != std::string::npos);
+}